@@ -0,0 +1,196 @@
+///**
+// * This test is completely single-threaded, it counts the heap allocations done by the queue
+// *  once it has warmed up (the task pool and the internal buffers reached their peak size)
+// *
+// */
+//
+//#include <cstddef>
+//#include <cstdlib>
+//
+//#include <array>
+//#include <atomic>
+//#include <iostream>
+//#include <memory>
+//#include <new>
+//#include <utility>
+//#include <vector>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//static std::atomic<std::size_t> allocations{ 0 };
+//
+//void* operator new(std::size_t size) {
+//    allocations.fetch_add(1, std::memory_order_relaxed);
+//    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+//        return ptr;
+//    }
+//    throw std::bad_alloc();
+//}
+//
+//void operator delete(void* ptr) noexcept {
+//    std::free(ptr);
+//}
+//
+//void operator delete(void* ptr, std::size_t) noexcept {
+//    std::free(ptr);
+//}
+//
+//// Runs the given enqueue-then-serve round a few times to warm up and then once more with counting.
+//template<typename Round>
+//static bool steady_state_allocations(Round&& round, std::size_t tasks) {
+//    constexpr std::size_t warmup_rounds = 3;
+//
+//    Queue queue;
+//    std::size_t done_tasks{ 0 };
+//
+//    for (std::size_t i = 0; i < warmup_rounds; ++i) {
+//        round(queue, done_tasks);
+//    }
+//
+//    done_tasks = 0;
+//    const std::size_t before = allocations.load();
+//    round(queue, done_tasks);
+//    const std::size_t allocated = allocations.load() - before;
+//
+//    if (done_tasks != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//        return false;
+//    }
+//
+//    if (allocated != 0) {
+//        PRINT_INDENTED("Expected no allocations in the steady state, but got " << allocated << " for " << tasks << " tasks");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(independent_tasks, "enqueue and serve tasks without resources") {
+//    constexpr std::size_t tasks = 10'000;
+//
+//    return steady_state_allocations([](Queue& queue, std::size_t& done_tasks) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                ++done_tasks;
+//                }, writes(), reads());
+//        }
+//        queue.serve();
+//        }, tasks);
+//}
+//
+//TEST_CASE(tasks_with_resources, "enqueue and serve tasks writing and reading a few shared resources") {
+//    constexpr std::size_t tasks = 10'000;
+//
+//    return steady_state_allocations([](Queue& queue, std::size_t& done_tasks) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                ++done_tasks;
+//                }, writes(i % 64, 64 + i % 7, i % 64), reads((i + 1) % 64, 100, 64 + i % 7));
+//        }
+//        queue.serve();
+//        }, tasks);
+//}
+//
+//TEST_CASE(dynamic_resource_ranges, "enqueue and serve tasks with resources listed in vectors") {
+//    constexpr std::size_t tasks = 1'000;
+//    constexpr std::size_t resources = 256;
+//
+//    // Filled before counting, only the ranges themselves are passed to enqueue().
+//    std::vector<resource_id> write_ids(resources);
+//    std::vector<resource_id> read_ids(resources);
+//
+//    return steady_state_allocations([&](Queue& queue, std::size_t& done_tasks) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            // Descending and every id twice, so that the normalization has something to do.
+//            for (std::size_t k = 0; k < resources; ++k) {
+//                write_ids[k] = (i % 4) * resources + (resources - 1 - k / 2);
+//                read_ids[k] = ((i + 1) % 4) * resources + (resources - 1 - k / 2);
+//            }
+//
+//            queue.enqueue([&done_tasks]() {
+//                ++done_tasks;
+//                }, write_ids, read_ids);
+//        }
+//        queue.serve();
+//        }, tasks);
+//}
+//
+//TEST_CASE(inline_captures, "enqueue and serve tasks with captures filling the inline task storage") {
+//    constexpr std::size_t tasks = 10'000;
+//
+//    return steady_state_allocations([](Queue& queue, std::size_t& done_tasks) {
+//        std::array<std::size_t, Queue::task_inline_size / sizeof(std::size_t) - 1> payload{};
+//        payload.back() = 1;
+//
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks, payload]() {
+//                done_tasks += payload.back();
+//                }, writes(), reads());
+//        }
+//        queue.serve();
+//        }, tasks);
+//}
+//
+//TEST_CASE(move_only_tasks, "enqueue tasks owning their payload through a unique_ptr") {
+//    constexpr std::size_t tasks = 1'000;
+//
+//    Queue queue;
+//    std::size_t sum{ 0 };
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        auto payload = std::make_unique<std::size_t>(i);
+//        queue.enqueue([&sum, payload = std::move(payload)]() {
+//            sum += *payload;
+//            }, writes(), reads());
+//    }
+//    queue.serve();
+//
+//    if (sum != tasks * (tasks - 1) / 2) {
+//        PRINT_INDENTED("Tasks did not see their payloads, expected sum " << tasks * (tasks - 1) / 2 << " but got " << sum);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!independent_tasks()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!tasks_with_resources()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!dynamic_resource_ranges()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!inline_captures()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!move_only_tasks()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
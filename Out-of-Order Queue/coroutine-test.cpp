@@ -0,0 +1,210 @@
+///**
+// * Tests the coroutine tasks, which acquire the resources of their later stages with co_await
+// *  instead of being split into separate tasks: the stages are ordered like tasks enqueued at the
+// *  point of the acquisition, run exclusively on their resources and free their frames when done.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <iostream>
+//#include <string>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    // Counts the frames still alive through an object living in each of them.
+//    struct FrameGuard {
+//        std::atomic<std::size_t>& alive;
+//
+//        explicit FrameGuard(std::atomic<std::size_t>& alive) : alive(alive) { alive++; }
+//        ~FrameGuard() { alive--; }
+//    };
+//
+//    Queue::Coroutine two_stages(Queue& queue, std::string& log) {
+//        log += "a";
+//        co_await queue.acquire(writes(1), reads());
+//        log += "c";
+//    }
+//
+//    // Every stage adds to the resource it writes, and checks that no other task is using it meanwhile.
+//    Queue::Coroutine pipeline(Queue& queue, std::vector<std::size_t>& values, std::vector<std::atomic<bool>>& busy,
+//        std::atomic<std::size_t>& conflicts, std::atomic<std::size_t>& alive, std::size_t first, std::size_t stages) {
+//        const FrameGuard guard(alive);
+//
+//        const auto use = [&](std::size_t r) {
+//            if (busy[r].exchange(true)) conflicts++;
+//            values[r]++;
+//            busy[r].store(false);
+//            };
+//
+//        use(first);
+//        for (std::size_t stage = 1; stage < stages; ++stage) {
+//            const std::size_t r = (first + stage * 3) % values.size();
+//            co_await queue.acquire(writes(r), reads());
+//            use(r);
+//        }
+//    }
+//
+//} // namespace
+//
+//TEST_CASE(acquire_order, "a resource acquired mid-flight waits for the task enqueued on it before the acquisition") {
+//    Queue queue;
+//    std::string log;
+//
+//    queue.enqueue(two_stages(queue, log), writes(0), reads());
+//    queue.enqueue([&log]() {
+//        log += "b";
+//        }, writes(1), reads());
+//
+//    queue.serve();
+//
+//    if (log != "abc") {
+//        PRINT_INDENTED("The stages ran in the order \"" << log << "\", expected \"abc\"");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(released_on_suspend, "the resources of a stage are released once the coroutine suspends") {
+//    Queue queue;
+//    std::string log;
+//
+//    // The task on resource 0 only waits for the first stage, the second one is ready right away,
+//    //  but it is enqueued only when the first stage suspends.
+//    queue.enqueue([&log]() {
+//        log += "x";
+//        }, writes(1), reads());
+//    queue.enqueue(two_stages(queue, log), writes(0), reads());
+//    queue.enqueue([&log]() {
+//        log += "b";
+//        }, writes(0), reads());
+//
+//    queue.serve();
+//
+//    if (log != "xabc") {
+//        PRINT_INDENTED("The stages ran in the order \"" << log << "\", expected \"xabc\"");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//static bool pipelines_test(QueueOptions options) {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t coroutines = 2'000;
+//    constexpr std::size_t stages = 5;
+//    constexpr std::size_t resources = 16;
+//
+//    Queue queue(options);
+//
+//    std::vector<std::size_t> values(resources, 0);
+//    std::vector<std::atomic<bool>> busy(resources);
+//    std::atomic<std::size_t> conflicts{ 0 };
+//    std::atomic<std::size_t> alive{ 0 };
+//    std::atomic<std::size_t> plain_tasks{ 0 };
+//
+//    for (std::size_t i = 0; i < coroutines; ++i) {
+//        const std::size_t first = i % resources;
+//        queue.enqueue(pipeline(queue, values, busy, conflicts, alive, first, stages), writes(first), reads());
+//
+//        // Plain tasks on the same resources in between.
+//        const std::size_t r = (i * 7) % resources;
+//        queue.enqueue([&values, &busy, &conflicts, &plain_tasks, r]() {
+//            if (busy[r].exchange(true)) conflicts++;
+//            values[r]++;
+//            busy[r].store(false);
+//            plain_tasks++;
+//            }, writes(r), reads());
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    std::size_t total = 0;
+//    for (std::size_t value : values) total += value;
+//
+//    if (plain_tasks.load() != coroutines || total != coroutines * (stages + 1)) {
+//        PRINT_INDENTED("The resources were used " << total << " times, expected " << coroutines * (stages + 1));
+//        return false;
+//    }
+//    if (conflicts.load() != 0) {
+//        PRINT_INDENTED(conflicts.load() << " stages used a resource at the same time as another task");
+//        return false;
+//    }
+//    if (alive.load() != 0) {
+//        PRINT_INDENTED(alive.load() << " coroutine frames were not freed");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(pipelines, "multi-stage coroutines mixed with plain tasks, served by multiple workers") {
+//    return pipelines_test(QueueOptions{});
+//}
+//
+//TEST_CASE(pipelines_stealing, "multi-stage coroutines mixed with plain tasks, served by multiple work stealing workers") {
+//    return pipelines_test(QueueOptions{ .scheduling = Scheduling::work_stealing });
+//}
+//
+//TEST_CASE(pipelines_in_workers, "multi-stage coroutines mixed with plain tasks, served by the worker threads of the queue") {
+//    return pipelines_test(QueueOptions{ .worker_threads = 4 });
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!acquire_order()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!released_on_suspend()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!pipelines()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!pipelines_stealing()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!pipelines_in_workers()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
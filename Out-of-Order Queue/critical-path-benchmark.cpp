@@ -0,0 +1,130 @@
+///**
+// * Measures the makespan of a synthetic DAG with an unbalanced critical path: a long chain
+// *  of slow tasks enqueued behind a wide layer of short independent ones. FIFO dispatch runs
+// *  the chain one step per pass over the backlog, the critical path scheduling keeps it going.
+// * Every configuration runs the DAG a few times, the first round learns the costs.
+// * The tasks sleep instead of computing, so that the makespan does not depend on the number of cores.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <algorithm>
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    constexpr cost_class_id short_class = 0;
+//    constexpr cost_class_id chain_class = 1;
+//
+//} // namespace
+//
+//static bool makespan_benchmark(std::size_t workers, std::size_t chains, std::size_t chain_length, std::size_t short_tasks) {
+//    constexpr std::size_t rounds = 5;
+//    constexpr auto short_work = std::chrono::microseconds(100);
+//    constexpr auto chain_work = std::chrono::microseconds(200);
+//
+//    const Scheduling schedulings[] = { Scheduling::fifo, Scheduling::critical_path };
+//
+//    for (const Scheduling scheduling : schedulings) {
+//        Queue queue(QueueOptions{ .scheduling = scheduling });
+//
+//        std::vector<std::size_t> steps(chains, 0);
+//        std::atomic<std::size_t> done_tasks{ 0 };
+//        double total{ 0 };
+//
+//        for (std::size_t round = 0; round < rounds; ++round) {
+//            // The short tasks come first, so every chain step that becomes ready queues behind them.
+//            for (std::size_t i = 0; i < short_tasks; ++i) {
+//                queue.enqueue([&done_tasks, short_work]() {
+//                    std::this_thread::sleep_for(short_work);
+//                    done_tasks.fetch_add(1, std::memory_order_relaxed);
+//                    }, writes(), reads(), Priority::normal, short_class);
+//            }
+//            for (std::size_t step = 0; step < chain_length; ++step) {
+//                for (std::size_t c = 0; c < chains; ++c) {
+//                    queue.enqueue([&steps, &done_tasks, c, chain_work]() {
+//                        std::this_thread::sleep_for(chain_work);
+//                        steps[c]++;
+//                        done_tasks.fetch_add(1, std::memory_order_relaxed);
+//                        }, writes(c), reads(), Priority::normal, chain_class);
+//                }
+//            }
+//
+//            const auto start = std::chrono::steady_clock::now();
+//
+//            std::vector<std::thread> threads;
+//            threads.reserve(workers);
+//
+//            for (std::size_t i = 0; i < workers; ++i) {
+//                threads.emplace_back([&queue]() {
+//                    queue.serve();
+//                    });
+//            }
+//
+//            for (auto& thread : threads) {
+//                thread.join();
+//            }
+//
+//            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+//            if (round > 0) total += elapsed.count();
+//        }
+//
+//        const std::size_t expected = rounds * (short_tasks + chains * chain_length);
+//        if (done_tasks.load() != expected) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << expected << " but got " << done_tasks.load());
+//            return false;
+//        }
+//        if (std::ranges::any_of(steps, [chain_length](std::size_t s) { return s != rounds * chain_length; })) {
+//            PRINT_INDENTED("A chain did not run all of its steps");
+//            return false;
+//        }
+//
+//        PRINT_INDENTED((scheduling == Scheduling::fifo ? "fifo" : "critical path") << ": " << total / (rounds - 1) << " ms");
+//    }
+//
+//    const double work = short_tasks * 0.1 + chains * chain_length * 0.2;
+//    PRINT_INDENTED("lower bound: " << std::max(work / workers, chain_length * 0.2) << " ms");
+//    return true;
+//}
+//
+//TEST_CASE(one_chain, "4 workers, a chain of 200 tasks of 200 us behind 2000 independent tasks of 100 us") {
+//    return makespan_benchmark(4, 1, 200, 2'000);
+//}
+//
+//TEST_CASE(two_chains, "8 workers, two chains of 200 tasks of 200 us behind 4000 independent tasks of 100 us") {
+//    return makespan_benchmark(8, 2, 200, 4'000);
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!one_chain()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!two_chains()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
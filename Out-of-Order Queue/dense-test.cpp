@@ -0,0 +1,230 @@
+///**
+// * Tests the queue for dense resource ids: the tasks are ordered exactly as by the default queue,
+// *  with the ids listed in any order and with duplicates, one at a time or in a batch.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <iostream>
+//#include <stdexcept>
+//#include <string>
+//#include <tuple>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    constexpr std::size_t dense_ids = 1'024;
+//    using DenseQueue = BasicQueue<DenseQueueTraits<dense_ids>>;
+//
+//} // namespace
+//
+//template<class TestedQueue>
+//static std::string duplicates_order() {
+//    TestedQueue queue;
+//    std::string log;
+//
+//    queue.enqueue([&log]() { log += "a"; }, writes(5, 3, 5, 1023), reads(3, 3));
+//    queue.enqueue([&log]() { log += "b"; }, writes(), reads(1023, 5, 1023));
+//    queue.enqueue([&log]() { log += "c"; }, writes(), reads(5));
+//    queue.enqueue([&log]() { log += "d"; }, writes(3, 3), reads());
+//    queue.enqueue([&log]() { log += "e"; }, writes(1023, 5), reads());
+//    queue.enqueue([&log]() { log += "f"; }, writes(7), reads());
+//
+//    queue.serve();
+//    return log;
+//}
+//
+//TEST_CASE(duplicates, "ids listed several times, as writes and as reads of the same task, are ordered as by the default queue") {
+//    const std::string log = duplicates_order<DenseQueue>();
+//    const std::string expected = duplicates_order<Queue>();
+//
+//    if (log != expected) {
+//        PRINT_INDENTED("The tasks ran in the order \"" << log << "\", expected \"" << expected << "\"");
+//        return false;
+//    }
+//    if (log.size() != 6 || log.back() != 'e') {
+//        PRINT_INDENTED("The tasks ran in the order \"" << log << "\", the last writer did not wait for the readers");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//// The ids are spread over the whole dense range, with duplicates and not sorted.
+//template<class TestedQueue>
+//static bool same_values_test(std::size_t batch_size) {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 20'000;
+//    constexpr std::size_t resources = 50;
+//    constexpr std::size_t spread = dense_ids / resources;
+//
+//    TestedQueue queue(QueueOptions{ .scheduling = Scheduling::work_stealing });
+//
+//    std::vector<std::size_t> values(dense_ids, 0);
+//    std::vector<std::size_t> expected(dense_ids, 0);
+//    std::atomic<std::size_t> runs{ 0 };
+//
+//    const auto make_task = [&values, &runs](resource_id w, resource_id r) {
+//        return [&values, &runs, w, r]() {
+//            values[w] = values[w] * 3 + values[r] % 5 + 1;
+//            runs++;
+//            };
+//        };
+//    using Task = decltype(make_task(0, 0));
+//    std::vector<std::tuple<Task, decltype(writes(0, 0)), decltype(reads(0, 0, 0))>> batch;
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        const resource_id w = (i % resources) * spread;
+//        const resource_id r = ((i * 7 + 3) % resources) * spread;
+//        expected[w] = expected[w] * 3 + expected[r] % 5 + 1;
+//
+//        if (batch_size == 1) {
+//            queue.enqueue(make_task(w, r), writes(w, w), reads(r + 1, r, w));
+//            continue;
+//        }
+//
+//        batch.emplace_back(make_task(w, r), writes(w, w), reads(r + 1, r, w));
+//        if (batch.size() == batch_size || i + 1 == tasks) {
+//            queue.enqueue_batch(std::move(batch));
+//            batch.clear();
+//        }
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (runs.load() != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << runs.load());
+//        return false;
+//    }
+//
+//    if (values != expected) {
+//        PRINT_INDENTED("A resource was written out of order");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(dense_in_workers, "tasks on shared dense ids are served by multiple workers in the order of their writes") {
+//    return same_values_test<DenseQueue>(1) && same_values_test<Queue>(1);
+//}
+//
+//TEST_CASE(dense_batches, "the same tasks enqueued in batches of 64") {
+//    return same_values_test<DenseQueue>(64) && same_values_test<Queue>(64);
+//}
+//
+//TEST_CASE(tracked, "only the dense ids whose states refer to a task are counted as tracked") {
+//    DenseQueue queue;
+//
+//    queue.enqueue([]() {}, writes(1, 2, 3, 999), reads(64));
+//
+//    if (queue.tracked_resources() != 5) {
+//        PRINT_INDENTED("The queue tracks " << queue.tracked_resources() << " resources, expected 5");
+//        return false;
+//    }
+//
+//    queue.serve();
+//    return true;
+//}
+//
+//TEST_CASE(out_of_range_ids, "ids at or above the bound are rejected, by enqueue() and by enqueue_batch(), and nothing is enqueued") {
+//    DenseQueue queue;
+//    std::size_t runs{ 0 };
+//
+//    // The lists are all vectors, so that they share the bitset that finds the duplicates.
+//    try {
+//        queue.enqueue([&runs]() { ++runs; }, std::vector<resource_id>{ 5, dense_ids }, std::vector<resource_id>{});
+//        PRINT_INDENTED("Enqueuing the id " << dense_ids << " did not throw");
+//        return false;
+//    }
+//    catch (const std::out_of_range&) {
+//    }
+//
+//    try {
+//        const auto task = [&runs]() { ++runs; };
+//        const std::vector<std::tuple<decltype(task), std::vector<resource_id>, std::vector<resource_id>>> batch{
+//            { task, { 5 }, {} },
+//            { task, { 6 }, { dense_ids + 64 } },
+//        };
+//        queue.enqueue_batch(batch);
+//        PRINT_INDENTED("Enqueuing the id " << dense_ids + 64 << " in a batch did not throw");
+//        return false;
+//    }
+//    catch (const std::out_of_range&) {
+//    }
+//
+//    // The ids seen before the bad ones are not taken for duplicates afterwards.
+//    queue.enqueue([&runs]() { ++runs; }, std::vector<resource_id>{ 5 }, std::vector<resource_id>{ 6 });
+//
+//    if (queue.tracked_resources() != 2) {
+//        PRINT_INDENTED("The queue tracks " << queue.tracked_resources() << " resources, expected 2");
+//        return false;
+//    }
+//
+//    queue.serve();
+//
+//    if (runs != 1) {
+//        PRINT_INDENTED("Expected 1 task to run, but " << runs << " did");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!duplicates()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!dense_in_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!dense_batches()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!tracked()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!out_of_range_ids()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -1,9 +1,12 @@
 //#include <cstddef>
 //
+//#include <atomic>
 //#include <chrono>
 //#include <iostream>
+//#include <stdexcept>
 //#include <vector>
 //#include <thread>
+//#include <tuple>
 //
 //#include "test-common.hpp"
 //
@@ -246,6 +249,193 @@
 //    return true;
 //}
 //
+//TEST_CASE(batch_write_write, "test a simple write-write dependency between multiple tasks enqueued in one batch") {
+//    constexpr std::size_t task_length_ms = 100;
+//    constexpr std::size_t tasks_delay_ms = 100;
+//    constexpr std::size_t tasks = 20;
+//
+//    const resource_id resource = 32;
+//
+//    Queue queue;
+//
+//    const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(tasks_delay_ms);
+//
+//    const auto task = [=]() {
+//        std::this_thread::sleep_for(std::chrono::milliseconds(task_length_ms));
+//        };
+//
+//    std::vector<std::tuple<decltype(task), decltype(writes(resource)), decltype(reads())>> batch;
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        batch.emplace_back(task, writes(resource), reads());
+//    }
+//
+//    queue.enqueue_batch(std::move(batch));
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(tasks);
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        threads.emplace_back([&queue, &start]() {
+//            std::this_thread::sleep_until(start);
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    const auto elapsed = std::chrono::steady_clock::now() - start;
+//    const std::size_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+//
+//    if (elapsed_ms < task_length_ms * tasks) {
+//        PRINT_INDENTED("Tasks finished too early, expected at least " << task_length_ms * tasks << "ms but got " << elapsed_ms);
+//        return false;
+//    }
+//
+//    if (elapsed_ms > task_length_ms * tasks + timeout_ms) {
+//        PRINT_INDENTED("Tasks finished too late, expected at most " << task_length_ms * tasks + timeout_ms << "ms but got " << elapsed_ms);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(many_reads_write, "test that a write waits for all the reads since the previous write, not only the last one") {
+//    constexpr std::size_t task_length_ms = 10;
+//    constexpr std::size_t tasks_delay_ms = 100;
+//    constexpr std::size_t readers = 10;
+//
+//    const resource_id resource = 32;
+//
+//    Queue queue;
+//
+//    const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(tasks_delay_ms);
+//
+//    std::atomic<std::size_t> finished_readers{ 0 };
+//    std::size_t seen_readers{ 0 };
+//
+//    // The readers enqueued first run the longest, so the last one finishes first.
+//    for (std::size_t i = 0; i < readers; ++i) {
+//        queue.enqueue([&finished_readers, i]() {
+//            std::this_thread::sleep_for(std::chrono::milliseconds(task_length_ms * (readers - i)));
+//            finished_readers++;
+//            }, writes(), reads(resource));
+//    }
+//
+//    queue.enqueue([&finished_readers, &seen_readers]() {
+//        seen_readers = finished_readers.load();
+//        }, writes(resource), reads());
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(readers);
+//
+//    for (std::size_t i = 0; i < readers; ++i) {
+//        threads.emplace_back([&queue, &start]() {
+//            std::this_thread::sleep_until(start);
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (seen_readers != readers) {
+//        PRINT_INDENTED("The write ran before all the reads finished, expected " << readers << " finished reads but got " << seen_readers);
+//        return false;
+//    }
+//
+//    const auto elapsed = std::chrono::steady_clock::now() - start;
+//    const std::size_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+//
+//    if (elapsed_ms > task_length_ms * readers + timeout_ms) {
+//        PRINT_INDENTED("Reads did not run in parallel, expected at most " << task_length_ms * readers + timeout_ms << "ms but got " << elapsed_ms);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//namespace {
+//
+//    // Throws when copied once the budget of copies is used up.
+//    struct ThrowingCopy {
+//        std::atomic<std::size_t>* runs;
+//        std::size_t* copies_left;
+//
+//        ThrowingCopy(std::atomic<std::size_t>* runs, std::size_t* copies_left) : runs(runs), copies_left(copies_left) {}
+//        ThrowingCopy(const ThrowingCopy& other) : runs(other.runs), copies_left(other.copies_left) {
+//            if (*copies_left == 0) throw std::runtime_error("copy failed");
+//            --*copies_left;
+//        }
+//
+//        void operator()() const { (*runs)++; }
+//    };
+//
+//} // namespace
+//
+//TEST_CASE(batch_copy_throws, "a batch or a graph whose callable throws while copied leaves nothing behind for the next one") {
+//    constexpr std::size_t unlimited = 1'000;
+//
+//    std::atomic<std::size_t> runs{ 0 };
+//    std::size_t copies_left = unlimited;
+//
+//    Queue queue;
+//
+//    std::vector<std::tuple<ThrowingCopy, decltype(writes(2, 3)), decltype(reads())>> failing_batch;
+//    failing_batch.emplace_back(ThrowingCopy(&runs, &copies_left), writes(2, 3), reads());
+//    failing_batch.emplace_back(ThrowingCopy(&runs, &copies_left), writes(4, 5), reads());
+//
+//    // The first task is created already when the second one fails to copy.
+//    bool thrown = false;
+//    copies_left = 1;
+//    try {
+//        queue.enqueue_batch(failing_batch);
+//    }
+//    catch (const std::runtime_error&) {
+//        thrown = true;
+//    }
+//    copies_left = unlimited;
+//
+//    std::vector<std::tuple<ThrowingCopy, decltype(writes(3)), decltype(reads())>> batch;
+//    batch.emplace_back(ThrowingCopy(&runs, &copies_left), writes(3), reads());
+//    queue.enqueue_batch(batch);
+//    queue.serve();
+//
+//    if (!thrown || runs.load() != 1) {
+//        PRINT_INDENTED("The batch after the failed one ran " << runs.load() << " tasks, expected 1");
+//        return false;
+//    }
+//
+//    TaskGraphRecorder recorder;
+//    recorder.add(writes(0), reads());
+//    recorder.add(writes(1), reads());
+//    const TaskGraph graph = recorder.build();
+//
+//    const std::vector<ThrowingCopy> tasks(2, ThrowingCopy(&runs, &copies_left));
+//    thrown = false;
+//    copies_left = 1;
+//    try {
+//        queue.submit(graph, tasks);
+//    }
+//    catch (const std::runtime_error&) {
+//        thrown = true;
+//    }
+//    copies_left = unlimited;
+//
+//    runs = 0;
+//    queue.submit(graph, tasks);
+//    queue.serve();
+//
+//    if (!thrown || runs.load() != 2) {
+//        PRINT_INDENTED("The graph submitted after the failed one ran " << runs.load() << " tasks, expected 2");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
 //int main() {
 //    std::size_t failed = 0;
 //    std::size_t total = 0;
@@ -275,6 +465,21 @@
 //        ++failed;
 //    }
 //
+//    ++total;
+//    if (!batch_write_write()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!many_reads_write()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!batch_copy_throws()) {
+//        ++failed;
+//    }
+//
 //    RESET_INDENT();
 //    PRINT_INDENTED();
 //
@@ -0,0 +1,508 @@
+///**
+// * Measures the cost of enqueue() alone, the tasks are only served after the measurement,
+// *  except for the batches which are enqueued while the workers are serving.
+// * The nested fan-out is measured as a whole, it compares publishing the tasks enqueued by a task
+// *  right away with publishing them together once the task has finished.
+// * The per-resource cases of small ids compare the default queue with the one for dense ids.
+// * The pages compare a buffer declared page by page as single ids with the same buffer declared as one range,
+// *  and the scene compares declaring every leaf of a tree of resource nodes with declaring its root.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <array>
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <span>
+//#include <vector>
+//#include <thread>
+//#include <tuple>
+//#include <utility>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//static constexpr std::size_t max_producers = 8;
+//
+//namespace {
+//
+//    // Runs the producer on the given number of threads at once and returns the achieved enqueues per second.
+//    template<typename Producer>
+//    double enqueue_with_producers(std::size_t producers, std::size_t tasks_per_producer, Producer&& producer) {
+//        std::vector<std::thread> threads;
+//        threads.reserve(producers);
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        for (std::size_t p = 0; p < producers; ++p) {
+//            threads.emplace_back([&producer, p, tasks_per_producer]() {
+//                for (std::size_t i = 0; i < tasks_per_producer; ++i) {
+//                    producer(p, i);
+//                }
+//                });
+//        }
+//
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+//        return static_cast<double>(producers * tasks_per_producer) / elapsed.count();
+//    }
+//
+//} // namespace
+//
+//// Every task writes 4 and reads 4 resources, the producer maps its index and the task index to the resource ids.
+//template<typename ResourceOf>
+//static bool multi_producer_benchmark(ResourceOf&& resource_of) {
+//    constexpr std::size_t tasks_per_producer = 50'000;
+//
+//    for (std::size_t shards : { std::size_t{ 1 }, std::size_t{ 16 }, std::size_t{ 64 } }) {
+//        PRINT_INDENTED(shards << " resource shards:");
+//        PUSH_INDENT();
+//
+//        for (std::size_t producers = 1; producers <= max_producers; producers *= 2) {
+//            Queue queue(QueueOptions{ .resource_shards = shards });
+//            std::size_t done_tasks{ 0 };
+//
+//            const double rate = enqueue_with_producers(producers, tasks_per_producer, [&](std::size_t p, std::size_t i) {
+//                const auto r = [&](std::size_t k) { return resource_of(p, i, k); };
+//                queue.enqueue([&done_tasks]() {
+//                    ++done_tasks;
+//                    }, writes(r(0), r(1), r(2), r(3)), reads(r(4), r(5), r(6), r(7)));
+//                });
+//
+//            queue.serve();
+//
+//            if (done_tasks != producers * tasks_per_producer) {
+//                PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << producers * tasks_per_producer << " but got " << done_tasks);
+//                return false;
+//            }
+//
+//            PRINT_INDENTED(producers << " producers: " << static_cast<std::size_t>(rate) << " enqueues/s");
+//        }
+//
+//        POP_INDENT();
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(disjoint_producers, "every producer works on its own set of 1024 resources") {
+//    return multi_producer_benchmark([](std::size_t p, std::size_t i, std::size_t k) {
+//        return static_cast<resource_id>(p * 1024 + (i * 8 + k) % 1024);
+//        });
+//}
+//
+//TEST_CASE(overlapping_producers, "all producers share one set of 1024 resources") {
+//    return multi_producer_benchmark([](std::size_t p, std::size_t i, std::size_t k) {
+//        return static_cast<resource_id>((p * 8 + i * 8 + k) % 1024);
+//        });
+//}
+//
+//// Ids of the shapes below that fit the queue for dense ids, the per-resource cases measure both queues.
+//static constexpr std::size_t dense_ids = 1 << 18;
+//using DenseQueue = BasicQueue<DenseQueueTraits<dense_ids>>;
+//
+//// Enqueues tasks declaring Resources writes and Resources reads each, the shapes follow many-dependencies.cpp.
+//template<class TestedQueue, std::size_t Resources, typename WriteOf, typename ReadOf>
+//static bool per_resource_benchmark(const char* name, WriteOf&& write_of, ReadOf&& read_of) {
+//    constexpr std::size_t tasks = 200;
+//
+//    TestedQueue queue;
+//    std::size_t done_tasks{ 0 };
+//
+//    const auto start = std::chrono::steady_clock::now();
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        [&] <std::size_t... I>(std::index_sequence<I...>) {
+//            queue.enqueue([&done_tasks]() {
+//                ++done_tasks;
+//                }, writes(write_of(i, I)...), reads(read_of(i, I)...));
+//        }(std::make_index_sequence<Resources>{});
+//    }
+//
+//    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+//
+//    queue.serve();
+//
+//    if (done_tasks != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//        return false;
+//    }
+//
+//    PRINT_INDENTED(name << ": " << elapsed.count() / (tasks * Resources * 2) << " ns per resource");
+//    return true;
+//}
+//
+//TEST_CASE(per_resource_same, "1024 writes and 1024 reads, every task uses the same resources, hashed and dense ids") {
+//    const auto write_of = [](std::size_t, std::size_t k) {
+//        return static_cast<resource_id>(k);
+//        };
+//    const auto read_of = [](std::size_t, std::size_t k) {
+//        return static_cast<resource_id>(1024 + k);
+//        };
+//    return per_resource_benchmark<Queue, 1024>("hashed", write_of, read_of)
+//        && per_resource_benchmark<DenseQueue, 1024>("dense", write_of, read_of);
+//}
+//
+//TEST_CASE(per_resource_chained, "1024 writes and 1024 reads, every task reads what the previous one wrote, hashed and dense ids") {
+//    const auto write_of = [](std::size_t i, std::size_t k) {
+//        return static_cast<resource_id>(i * 1024 + (k + i * 7) % 1024);
+//        };
+//    const auto read_of = [](std::size_t i, std::size_t k) {
+//        return static_cast<resource_id>((i + 1) * 1024 + (k + i * 7) % 1024);
+//        };
+//    return per_resource_benchmark<Queue, 1024>("hashed", write_of, read_of)
+//        && per_resource_benchmark<DenseQueue, 1024>("dense", write_of, read_of);
+//}
+//
+//TEST_CASE(per_resource_addresses, "1024 writes and 1024 reads of fresh, address-like resource ids") {
+//    return per_resource_benchmark<Queue, 1024>("hashed", [](std::size_t i, std::size_t k) {
+//        return static_cast<resource_id>((i * 2048 + k) * 64);
+//        }, [](std::size_t i, std::size_t k) {
+//            return static_cast<resource_id>((i * 2048 + 1024 + k) * 64);
+//        });
+//}
+//
+//TEST_CASE(batch_sizes, "enqueue() for every task compared to enqueue_batch() with growing batches, while workers serve") {
+//    constexpr std::size_t tasks = 262'144;
+//    constexpr std::size_t max_batch_size = 65'536;
+//    constexpr std::size_t workers = 4;
+//
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//    const auto task = [&done_tasks]() {
+//        done_tasks.fetch_add(1, std::memory_order_relaxed);
+//        };
+//
+//    // Every task writes 2 and reads 2 of 1024 resources, so the tasks of a batch depend on each other.
+//    std::vector<std::tuple<decltype(task), decltype(writes(0, 0)), decltype(reads(0, 0))>> descriptors;
+//    descriptors.reserve(tasks);
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        descriptors.emplace_back(task, writes(i % 1024, (i * 7 + 1) % 1024), reads((i + 3) % 1024, (i * 13 + 5) % 1024));
+//    }
+//
+//    // The producer is a task itself, so that the workers keep serving until it has enqueued everything.
+//    const auto produce = [&](std::size_t batch_size) {
+//        Queue queue;
+//        double elapsed_ns = 0;
+//        done_tasks = 0;
+//
+//        queue.enqueue([&]() {
+//            const auto start = std::chrono::steady_clock::now();
+//            if (batch_size == 0) {
+//                for (auto& [t, w, r] : descriptors) {
+//                    queue.enqueue(t, w, r);
+//                }
+//            }
+//            else {
+//                for (std::size_t first = 0; first < tasks; first += batch_size) {
+//                    queue.enqueue_batch(std::span(descriptors).subspan(first, batch_size));
+//                }
+//            }
+//            elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+//            }, writes(), reads());
+//
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&queue]() {
+//                queue.serve();
+//                });
+//        }
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        return elapsed_ns / tasks;
+//    };
+//
+//    const double single_ns = produce(0);
+//    if (done_tasks != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//        return false;
+//    }
+//    PRINT_INDENTED("enqueue(): " << single_ns << " ns per task");
+//
+//    for (std::size_t batch_size = 1; batch_size <= max_batch_size; batch_size *= 4) {
+//        const double batch_ns = produce(batch_size);
+//        if (done_tasks != tasks) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//            return false;
+//        }
+//        PRINT_INDENTED("enqueue_batch() of " << batch_size << ": " << batch_ns << " ns per task");
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(graph_replay, "enqueue() of every task of a frame compared to submitting a recorded graph of the frame") {
+//    constexpr std::size_t frame_tasks = 256;
+//    constexpr std::size_t frames = 1'000;
+//
+//    std::size_t done_tasks{ 0 };
+//    const auto task = [&done_tasks]() {
+//        ++done_tasks;
+//        };
+//
+//    // Every task writes 2 and reads 2 of 1024 resources, like in batch_sizes.
+//    const auto writes_of = [](std::size_t i) { return writes(i % 1024, (i * 7 + 1) % 1024); };
+//    const auto reads_of = [](std::size_t i) { return reads((i + 3) % 1024, (i * 13 + 5) % 1024); };
+//
+//    TaskGraphRecorder recorder;
+//    for (std::size_t i = 0; i < frame_tasks; ++i) {
+//        recorder.add(writes_of(i), reads_of(i));
+//    }
+//    const TaskGraph graph = recorder.build();
+//    const std::vector tasks(frame_tasks, task);
+//
+//    // Every frame is served before the next one is enqueued, only enqueueing is measured.
+//    std::chrono::duration<double, std::nano> enqueue_elapsed{ 0 };
+//    std::chrono::duration<double, std::nano> submit_elapsed{ 0 };
+//
+//    Queue enqueue_queue;
+//    Queue graph_queue;
+//
+//    for (std::size_t f = 0; f < frames; ++f) {
+//        const auto enqueue_start = std::chrono::steady_clock::now();
+//        for (std::size_t i = 0; i < frame_tasks; ++i) {
+//            enqueue_queue.enqueue(task, writes_of(i), reads_of(i));
+//        }
+//        enqueue_elapsed += std::chrono::steady_clock::now() - enqueue_start;
+//        enqueue_queue.serve();
+//
+//        const auto submit_start = std::chrono::steady_clock::now();
+//        graph_queue.submit(graph, tasks);
+//        submit_elapsed += std::chrono::steady_clock::now() - submit_start;
+//        graph_queue.serve();
+//    }
+//
+//    if (done_tasks != 2 * frames * frame_tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << 2 * frames * frame_tasks << " but got " << done_tasks);
+//        return false;
+//    }
+//
+//    PRINT_INDENTED("enqueue(): " << enqueue_elapsed.count() / (frames * frame_tasks) << " ns per task, submit(): "
+//        << submit_elapsed.count() / (frames * frame_tasks) << " ns per task");
+//    return true;
+//}
+//
+//// The tree is enqueued by its own tasks, every task enqueues the next level of its subtree.
+//TEST_CASE(nested_fan_out, "4 workers, a tree of 335'923 tasks with 6 children each, published right away or when their parent finishes") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t depth = 7;
+//    constexpr std::size_t fan_out = 6;
+//
+//    std::size_t expected_tasks = 0;
+//    for (std::size_t level = 0, width = 1; level <= depth; ++level, width *= fan_out) expected_tasks += width;
+//
+//    for (const bool deferred : { false, true }) {
+//        Queue queue(QueueOptions{ .defer_nested_enqueues = deferred });
+//        std::atomic<std::size_t> done_tasks{ 0 };
+//
+//        // Only the leaves use a resource, the first half of them shares it with the neighbouring leaf.
+//        const auto spawn = [&queue, &done_tasks](auto& self, std::size_t node, std::size_t level) -> void {
+//            done_tasks.fetch_add(1, std::memory_order_relaxed);
+//            if (level == depth) return;
+//
+//            for (std::size_t i = 0; i < fan_out; ++i) {
+//                const std::size_t child = node * fan_out + i;
+//                if (level + 1 == depth) {
+//                    queue.enqueue([&self, child, level]() {
+//                        self(self, child, level + 1);
+//                        }, writes(child / 2), reads());
+//                }
+//                else {
+//                    queue.enqueue([&self, child, level]() {
+//                        self(self, child, level + 1);
+//                        }, writes(), reads());
+//                }
+//            }
+//            };
+//
+//        queue.enqueue([&spawn]() {
+//            spawn(spawn, 0, 0);
+//            }, writes(), reads());
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&queue]() {
+//                queue.serve();
+//                });
+//        }
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+//
+//        if (done_tasks.load() != expected_tasks) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << expected_tasks << " but got " << done_tasks.load());
+//            return false;
+//        }
+//
+//        PRINT_INDENTED((deferred ? "published when the parent finishes" : "published right away") << ": " << elapsed.count() / expected_tasks << " ns per task");
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(buffer_pages, "tasks writing a 1 GiB buffer of 4 KiB pages, declared as 262'144 ids or as a single range") {
+//    constexpr std::size_t page = 4'096;
+//    constexpr std::size_t pages = (std::size_t{ 1 } << 30) / page;
+//    constexpr std::size_t tasks = 16;
+//
+//    std::vector<resource_id> ids(pages);
+//    for (std::size_t p = 0; p < pages; ++p) ids[p] = p * page;
+//
+//    for (const bool range : { false, true }) {
+//        Queue queue;
+//        std::size_t done_tasks{ 0 };
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            const auto task = [&done_tasks]() {
+//                ++done_tasks;
+//                };
+//
+//            if (range) {
+//                queue.enqueue(task, writes(resource_range{ 0, pages * page }), reads());
+//            }
+//            else {
+//                queue.enqueue(task, ids, reads());
+//            }
+//        }
+//
+//        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+//
+//        queue.serve();
+//
+//        if (done_tasks != tasks) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//            return false;
+//        }
+//
+//        PRINT_INDENTED((range ? "a single range" : "page ids") << ": " << elapsed.count() / tasks << " us per task");
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(scene_nodes, "tasks writing a scene of 1024 objects with 16 components each, as the scene node or as every component") {
+//    constexpr std::size_t objects = 1'024;
+//    constexpr std::size_t components = 16;
+//    constexpr std::size_t tasks = 16;
+//
+//    for (const bool whole_scene : { false, true }) {
+//        Queue queue;
+//        std::size_t done_tasks{ 0 };
+//
+//        const resource_node scene = queue.add_resource_node();
+//        std::vector<resource_node> leaves;
+//        leaves.reserve(objects * components);
+//        for (std::size_t o = 0; o < objects; ++o) {
+//            const resource_node object = queue.add_resource_node(scene);
+//            for (std::size_t c = 0; c < components; ++c) leaves.push_back(queue.add_resource_node(object));
+//        }
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            const auto task = [&done_tasks]() {
+//                ++done_tasks;
+//                };
+//
+//            if (whole_scene) {
+//                queue.enqueue(task, writes(scene), reads());
+//            }
+//            else {
+//                queue.enqueue(task, leaves, reads());
+//            }
+//        }
+//
+//        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+//
+//        queue.serve();
+//
+//        if (done_tasks != tasks) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks);
+//            return false;
+//        }
+//
+//        PRINT_INDENTED((whole_scene ? "the scene node" : "every component") << ": " << elapsed.count() / tasks << " us per task");
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!disjoint_producers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!overlapping_producers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!per_resource_same()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!per_resource_chained()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!per_resource_addresses()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!batch_sizes()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_replay()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!nested_fan_out()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!buffer_pages()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!scene_nodes()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
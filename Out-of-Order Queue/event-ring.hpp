@@ -0,0 +1,49 @@
+#ifndef EVENT_RING_HPP
+#define EVENT_RING_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-size circular log with a single writer, a full ring overwrites its oldest elements.
+// The slots are left uninitialized until written, so a large ring only costs the pages it uses.
+// The writer never waits, the count of pushed elements is published with release, so a reader
+//  that synchronizes with the writer otherwise (e.g. joins it) sees all of the kept ones.
+template<class T>
+class EventRing {
+public:
+    // The capacity is rounded up to a power of two.
+    explicit EventRing(std::size_t min_capacity)
+        : capacity(std::bit_ceil(min_capacity > 0 ? min_capacity : 1)), buffer(std::make_unique_for_overwrite<T[]>(capacity)) {}
+
+    // Only called by the writer.
+    void push(const T& value) {
+        const std::uint64_t n = pushed.load(std::memory_order_relaxed);
+        buffer[n & (capacity - 1)] = value;
+        pushed.store(n + 1, std::memory_order_release);
+    }
+
+    // Calls visit(value) for the kept elements, oldest first.
+    template<class Visit>
+    void for_each(Visit&& visit) const {
+        const std::uint64_t end = pushed.load(std::memory_order_acquire);
+        const std::uint64_t begin = end > capacity ? end - capacity : 0;
+        for (std::uint64_t n = begin; n < end; ++n) visit(buffer[n & (capacity - 1)]);
+    }
+
+    // Elements lost to the wrap-around.
+    std::uint64_t overwritten() const noexcept {
+        const std::uint64_t n = pushed.load(std::memory_order_acquire);
+        return n > capacity ? n - capacity : 0;
+    }
+
+private:
+    std::size_t capacity;
+    std::unique_ptr<T[]> buffer;
+    std::atomic<std::uint64_t> pushed{ 0 };
+};
+
+
+#endif // EVENT_RING_HPP
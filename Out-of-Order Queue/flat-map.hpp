@@ -0,0 +1,282 @@
+#ifndef FLAT_MAP_HPP
+#define FLAT_MAP_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLAT_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace flat_map_detail {
+
+    // One control byte per slot: empty, deleted, or the low 7 bits of the hash of a full slot.
+    using ctrl_t = std::int8_t;
+    inline constexpr ctrl_t ctrl_empty = -128;
+    inline constexpr ctrl_t ctrl_deleted = -2;
+
+    inline constexpr std::size_t group_width = 16;
+
+    // Looks at the control bytes of 16 consecutive slots at once, bit i of the returned masks stands for slot i.
+    class Group {
+    public:
+        explicit Group(const ctrl_t* pos) {
+#ifdef FLAT_MAP_SSE2
+            ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#else
+            std::memcpy(ctrl, pos, group_width);
+#endif
+        }
+
+        std::uint32_t match(ctrl_t h2) const {
+#ifdef FLAT_MAP_SSE2
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+#else
+            std::uint32_t mask = 0;
+            for (std::size_t i = 0; i < group_width; ++i) mask |= std::uint32_t{ ctrl[i] == h2 } << i;
+            return mask;
+#endif
+        }
+
+        std::uint32_t match_empty() const {
+            return match(ctrl_empty);
+        }
+
+        std::uint32_t match_empty_or_deleted() const {
+#ifdef FLAT_MAP_SSE2
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+#else
+            std::uint32_t mask = 0;
+            for (std::size_t i = 0; i < group_width; ++i) mask |= std::uint32_t{ ctrl[i] < -1 } << i;
+            return mask;
+#endif
+        }
+
+    private:
+#ifdef FLAT_MAP_SSE2
+        __m128i ctrl;
+#else
+        ctrl_t ctrl[group_width];
+#endif
+    };
+
+} // namespace flat_map_detail
+
+
+// Open-addressing hash map with the keys and values stored inline in one flat array.
+// Slots are probed a group of 16 at a time by comparing 7 bits of the hash kept in a separate
+//  control byte array, so a lookup usually touches one cache line of control bytes and one slot.
+// Erased slots become tombstones that are cleaned up by the next rehash.
+template<class Key, class Value, class Hash>
+class FlatHashMap {
+public:
+    FlatHashMap() = default;
+    ~FlatHashMap();
+
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    // Returns nullptr if the key is not present.
+    Value* find(const Key& key);
+
+    // Returns the value of the key, default-constructs it first if the key is not present.
+    Value& operator[](const Key& key);
+
+    bool erase(const Key& key);
+
+    // Looks at the next slots after the ones of the previous call and erases the entries
+    //  whose value the predicate reports as dead, returns how many were erased.
+    // A few steps per insertion keep cycling through the whole table before it has to grow.
+    template<class Dead>
+    std::size_t sweep(std::size_t steps, Dead&& dead);
+
+    std::size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+private:
+    using ctrl_t = flat_map_detail::ctrl_t;
+    using Group = flat_map_detail::Group;
+    static constexpr std::size_t group_width = flat_map_detail::group_width;
+
+    struct Slot {
+        Key key;
+        Value value;
+    };
+
+    static std::size_t max_load(std::size_t capacity) { return capacity - capacity / 8; }
+
+    // Calls visit(index) for every candidate slot in the probe sequence of the hash until it returns true,
+    //  stops with false at the first group that has an empty slot.
+    template<class Visit>
+    bool probe(std::size_t hash, Visit&& visit) const;
+
+    std::size_t find_index(const Key& key, std::size_t hash) const;
+    std::size_t find_insert_index(std::size_t hash) const;
+    void rehash(std::size_t new_capacity);
+    void release();
+
+    ctrl_t* ctrl = nullptr;
+    Slot* slots = nullptr;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+    std::size_t growth_left = 0;
+    std::size_t sweep_cursor = 0;
+};
+
+
+template<class Key, class Value, class Hash>
+FlatHashMap<Key, Value, Hash>::~FlatHashMap() {
+    release();
+}
+
+template<class Key, class Value, class Hash>
+template<class Visit>
+bool FlatHashMap<Key, Value, Hash>::probe(std::size_t hash, Visit&& visit) const {
+    const std::size_t group_mask = capacity / group_width - 1;
+    std::size_t group = (hash >> 7) & group_mask;
+
+    // Triangular steps visit every group exactly once when their number is a power of two.
+    for (std::size_t step = 1; step <= group_mask + 1; ++step) {
+        const Group g(ctrl + group * group_width);
+        for (std::uint32_t mask = g.match(static_cast<ctrl_t>(hash & 0x7F)); mask != 0; mask &= mask - 1) {
+            if (visit(group * group_width + std::countr_zero(mask))) return true;
+        }
+        if (g.match_empty() != 0) return false;
+
+        group = (group + step) & group_mask;
+    }
+    return false;
+}
+
+template<class Key, class Value, class Hash>
+std::size_t FlatHashMap<Key, Value, Hash>::find_index(const Key& key, std::size_t hash) const {
+    std::size_t found = capacity;
+    if (capacity == 0) return found;
+
+    probe(hash, [&](std::size_t index) {
+        if (!(slots[index].key == key)) return false;
+        found = index;
+        return true;
+        });
+    return found;
+}
+
+template<class Key, class Value, class Hash>
+std::size_t FlatHashMap<Key, Value, Hash>::find_insert_index(std::size_t hash) const {
+    const std::size_t group_mask = capacity / group_width - 1;
+    std::size_t group = (hash >> 7) & group_mask;
+
+    for (std::size_t step = 1; ; ++step) {
+        if (std::uint32_t mask = Group(ctrl + group * group_width).match_empty_or_deleted(); mask != 0) {
+            return group * group_width + std::countr_zero(mask);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+template<class Key, class Value, class Hash>
+Value* FlatHashMap<Key, Value, Hash>::find(const Key& key) {
+    const std::size_t index = find_index(key, Hash{}(key));
+    return index == capacity ? nullptr : &slots[index].value;
+}
+
+template<class Key, class Value, class Hash>
+Value& FlatHashMap<Key, Value, Hash>::operator[](const Key& key) {
+    const std::size_t hash = Hash{}(key);
+
+    if (const std::size_t index = find_index(key, hash); index != capacity) {
+        return slots[index].value;
+    }
+
+    if (growth_left == 0) {
+        // Mostly tombstones: clean them up, shrinking the table if the entries fit a smaller one,
+        //  otherwise double the capacity.
+        rehash(count * 2 < max_load(capacity)
+            ? std::max(group_width, std::min(capacity, std::bit_ceil(count * 4)))
+            : std::max(capacity * 2, group_width));
+    }
+
+    const std::size_t index = find_insert_index(hash);
+    if (ctrl[index] == flat_map_detail::ctrl_empty) growth_left--;
+    ctrl[index] = static_cast<ctrl_t>(hash & 0x7F);
+    ++count;
+
+    ::new (static_cast<void*>(&slots[index])) Slot{ key, Value{} };
+    return slots[index].value;
+}
+
+template<class Key, class Value, class Hash>
+bool FlatHashMap<Key, Value, Hash>::erase(const Key& key) {
+    const std::size_t index = find_index(key, Hash{}(key));
+    if (index == capacity) return false;
+
+    slots[index].~Slot();
+    ctrl[index] = flat_map_detail::ctrl_deleted;
+    --count;
+    return true;
+}
+
+template<class Key, class Value, class Hash>
+template<class Dead>
+std::size_t FlatHashMap<Key, Value, Hash>::sweep(std::size_t steps, Dead&& dead) {
+    std::size_t erased = 0;
+
+    for (; steps > 0 && count > 0; --steps) {
+        const std::size_t index = sweep_cursor++ & (capacity - 1);
+        if (ctrl[index] < 0 || !dead(slots[index].value)) continue;
+
+        slots[index].~Slot();
+        ctrl[index] = flat_map_detail::ctrl_deleted;
+        --count;
+        ++erased;
+    }
+
+    return erased;
+}
+
+template<class Key, class Value, class Hash>
+void FlatHashMap<Key, Value, Hash>::rehash(std::size_t new_capacity) {
+    ctrl_t* old_ctrl = std::exchange(ctrl, new ctrl_t[new_capacity]);
+    Slot* old_slots = std::exchange(slots, std::allocator<Slot>{}.allocate(new_capacity));
+    const std::size_t old_capacity = std::exchange(capacity, new_capacity);
+
+    std::memset(ctrl, flat_map_detail::ctrl_empty, capacity);
+    growth_left = max_load(capacity) - count;
+
+    for (std::size_t i = 0; i < old_capacity; ++i) {
+        if (old_ctrl[i] < 0) continue;
+
+        Slot& old = old_slots[i];
+        const std::size_t index = find_insert_index(Hash{}(old.key));
+        ctrl[index] = old_ctrl[i];
+        ::new (static_cast<void*>(&slots[index])) Slot{ std::move(old) };
+        old.~Slot();
+    }
+
+    delete[] old_ctrl;
+    if (old_slots) std::allocator<Slot>{}.deallocate(old_slots, old_capacity);
+}
+
+template<class Key, class Value, class Hash>
+void FlatHashMap<Key, Value, Hash>::release() {
+    for (std::size_t i = 0; i < capacity; ++i) {
+        if (ctrl[i] >= 0) slots[i].~Slot();
+    }
+
+    delete[] ctrl;
+    if (slots) std::allocator<Slot>{}.deallocate(slots, capacity);
+
+    ctrl = nullptr;
+    slots = nullptr;
+    capacity = count = growth_left = 0;
+}
+
+
+#endif // FLAT_MAP_HPP
@@ -0,0 +1,242 @@
+///**
+// * Every task mixes the values of the resources it reads into the ones it writes,
+// *  so the final values only match the sequential execution if the graph kept all the dependencies.
+// *
+// */
+//
+//#include <cstddef>
+//#include <cstdint>
+//
+//#include <functional>
+//#include <iostream>
+//#include <random>
+//#include <stdexcept>
+//#include <vector>
+//#include <thread>
+//#include <utility>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    struct RecordedTask {
+//        std::vector<resource_id> writes;
+//        std::vector<resource_id> reads;
+//    };
+//
+//    class MixTask {
+//    public:
+//        MixTask(const RecordedTask* recorded, std::vector<std::uint64_t>* values, std::uint64_t seed)
+//            : recorded_(recorded), values_(values), seed_(seed) {
+//        }
+//
+//        void operator()() const {
+//            std::uint64_t mixed = seed_;
+//            for (resource_id r : recorded_->reads) {
+//                mixed = mixed * 31 + (*values_)[r];
+//            }
+//            for (resource_id w : recorded_->writes) {
+//                (*values_)[w] = (*values_)[w] * 17 + mixed;
+//            }
+//        }
+//
+//    private:
+//        const RecordedTask* recorded_;
+//        std::vector<std::uint64_t>* values_;
+//        std::uint64_t seed_;
+//    };
+//
+//} // namespace
+//
+//static bool graph_test(QueueOptions options) {
+//    constexpr std::size_t resources = 16;
+//    constexpr std::size_t graph_tasks = 64;
+//    constexpr std::size_t submissions = 200;
+//    constexpr std::size_t workers = 4;
+//
+//    std::mt19937 generator(42);
+//    std::uniform_int_distribution<resource_id> resource(0, resources - 1);
+//    std::uniform_int_distribution<std::size_t> count(0, 3);
+//
+//    std::vector<RecordedTask> recorded(graph_tasks);
+//    TaskGraphRecorder recorder;
+//
+//    for (auto& task : recorded) {
+//        for (std::size_t i = count(generator) / 2 + 1; i > 0; --i) task.writes.push_back(resource(generator));
+//        for (std::size_t i = count(generator); i > 0; --i) task.reads.push_back(resource(generator));
+//        recorder.add(task.writes, task.reads);
+//    }
+//
+//    const TaskGraph graph = recorder.build();
+//
+//    if (graph.size() != graph_tasks) {
+//        PRINT_INDENTED("The graph has " << graph.size() << " tasks but " << graph_tasks << " were recorded");
+//        return false;
+//    }
+//
+//    std::vector<std::uint64_t> expected(resources, 1);
+//    std::vector<std::uint64_t> values(resources, 1);
+//
+//    Queue queue(options);
+//
+//    for (std::size_t s = 0; s < submissions; ++s) {
+//        std::vector<MixTask> tasks;
+//        tasks.reserve(graph_tasks);
+//
+//        for (std::size_t t = 0; t < graph_tasks; ++t) {
+//            const std::uint64_t seed = s * graph_tasks + t;
+//            MixTask(&recorded[t], &expected, seed)();
+//            tasks.emplace_back(&recorded[t], &values, seed);
+//        }
+//
+//        queue.submit(graph, std::move(tasks));
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    for (std::size_t r = 0; r < resources; ++r) {
+//        if (values[r] != expected[r]) {
+//            PRINT_INDENTED("Resource " << r << " differs from the sequential execution, expected " << expected[r] << " but got " << values[r]);
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(graph_fifo, "submit a random graph many times and serve it with multiple workers") {
+//    return graph_test(QueueOptions{});
+//}
+//
+//TEST_CASE(graph_work_stealing, "submit a random graph many times and serve it with work stealing workers") {
+//    return graph_test(QueueOptions{ .scheduling = Scheduling::work_stealing, .ready_queue_capacity = 256 });
+//}
+//
+//TEST_CASE(graph_critical_path, "submit a random graph many times and serve it with critical path scheduling") {
+//    return graph_test(QueueOptions{ .scheduling = Scheduling::critical_path });
+//}
+//
+//TEST_CASE(graph_copied_tasks, "submit the same callables many times, they are copied") {
+//    constexpr std::size_t submissions = 1'000;
+//
+//    TaskGraphRecorder recorder;
+//    recorder.add(writes(0), reads());
+//    recorder.add(writes(1), reads(0));
+//    recorder.add(writes(0), reads(1));
+//
+//    const TaskGraph graph = recorder.build();
+//
+//    std::size_t value{ 0 };
+//    const std::vector<std::function<void()>> tasks{
+//        [&value]() { value = value * 2; },
+//        [&value]() { value = value + 1; },
+//        [&value]() { value = value * 3; },
+//    };
+//
+//    Queue queue;
+//
+//    for (std::size_t s = 0; s < submissions; ++s) {
+//        queue.submit(graph, tasks);
+//    }
+//
+//    queue.serve();
+//
+//    std::size_t expected{ 0 };
+//    for (std::size_t s = 0; s < submissions; ++s) {
+//        expected = (expected * 2 + 1) * 3;
+//    }
+//
+//    if (value != expected) {
+//        PRINT_INDENTED("The tasks did not run in the recorded order, expected " << expected << " but got " << value);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(graph_task_count_mismatch, "submit fewer and more callables than the graph has tasks, both are rejected") {
+//    TaskGraphRecorder recorder;
+//    recorder.add(writes(0), reads());
+//    recorder.add(writes(1), reads(0));
+//
+//    const TaskGraph graph = recorder.build();
+//
+//    std::size_t runs{ 0 };
+//    const std::function<void()> task = [&runs]() { ++runs; };
+//
+//    Queue queue;
+//
+//    for (std::size_t count : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 3 } }) {
+//        try {
+//            queue.submit(graph, std::vector<std::function<void()>>(count, task));
+//            PRINT_INDENTED("Submitting " << count << " callables for a graph of " << graph.size() << " tasks did not throw");
+//            return false;
+//        }
+//        catch (const std::invalid_argument&) {
+//        }
+//    }
+//
+//    // The queue stays usable after the rejected submissions.
+//    queue.submit(graph, std::vector<std::function<void()>>(graph.size(), task));
+//    queue.serve();
+//
+//    if (runs != graph.size()) {
+//        PRINT_INDENTED("Expected " << graph.size() << " tasks to run, but " << runs << " did");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!graph_fifo()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_work_stealing()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_critical_path()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_copied_tasks()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_task_count_mismatch()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,262 @@
+///**
+// * Tests the handles returned by enqueue_with_handle(), waited for both from outside
+// *  of the queue and from inside of its tasks, where the waiting thread helps serving.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <stdexcept>
+//#include <string>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//TEST_CASE(results, "take the results of a chain of tasks from outside of the queue") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 1'000;
+//
+//    Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//    std::size_t value{ 0 };
+//    std::vector<Queue::TaskHandle<std::size_t>> handles;
+//    handles.reserve(tasks);
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        handles.push_back(queue.enqueue_with_handle([&value]() {
+//            return ++value;
+//            }, writes(0), reads()));
+//    }
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        const std::size_t result = handles[i].get();
+//        if (result != i + 1) {
+//            PRINT_INDENTED("Task " << i << " returned " << result << " but " << i + 1 << " was expected");
+//            return false;
+//        }
+//        if (handles[i].valid()) {
+//            PRINT_INDENTED("Handle " << i << " is still valid after get()");
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(exceptions, "an exception thrown by a task is rethrown by get() and does not stop the workers") {
+//    Queue queue;
+//
+//    auto failing = queue.enqueue_with_handle([]() -> std::string {
+//        throw std::runtime_error("task failed");
+//        }, writes(0), reads());
+//    auto following = queue.enqueue_with_handle([]() {
+//        return std::string("done");
+//        }, writes(0), reads());
+//
+//    queue.serve();
+//
+//    if (!failing.ready() || !following.ready()) {
+//        PRINT_INDENTED("The tasks have not finished after serve()");
+//        return false;
+//    }
+//
+//    try {
+//        failing.get();
+//        PRINT_INDENTED("get() did not rethrow the exception of the task");
+//        return false;
+//    }
+//    catch (const std::runtime_error& error) {
+//        if (std::string(error.what()) != "task failed") {
+//            PRINT_INDENTED("get() threw a different exception: " << error.what());
+//            return false;
+//        }
+//    }
+//
+//    if (following.get() != "done") {
+//        PRINT_INDENTED("The task after the failed one did not return its result");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//namespace {
+//
+//    // Every call waits for the two recursive ones, so all but the leaves wait inside a task.
+//    std::size_t fibonacci(Queue& queue, std::size_t n) {
+//        if (n < 2) {
+//            return n;
+//        }
+//
+//        auto first = queue.enqueue_with_handle([&queue, n]() {
+//            return fibonacci(queue, n - 1);
+//            }, writes(), reads());
+//        auto second = queue.enqueue_with_handle([&queue, n]() {
+//            return fibonacci(queue, n - 2);
+//            }, writes(), reads());
+//
+//        return first.get() + second.get();
+//    }
+//
+//} // namespace
+//
+//static bool fibonacci_test(std::size_t workers, QueueOptions options) {
+//    constexpr std::size_t n = 16;
+//    constexpr std::size_t expected = 987;
+//
+//    Queue queue(options);
+//
+//    auto result = queue.enqueue_with_handle([&queue]() {
+//        return fibonacci(queue, n);
+//        }, writes(), reads());
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    const std::size_t value = result.get();
+//    if (value != expected) {
+//        PRINT_INDENTED("Computed " << value << " but " << expected << " was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(wait_in_single_worker, "tasks wait for their subtasks with a single worker, which has to run them itself") {
+//    return fibonacci_test(1, QueueOptions{});
+//}
+//
+//TEST_CASE(wait_in_workers, "tasks wait for their subtasks with multiple workers") {
+//    return fibonacci_test(4, QueueOptions{});
+//}
+//
+//TEST_CASE(wait_in_stealing_workers, "tasks wait for their subtasks with multiple work stealing workers") {
+//    return fibonacci_test(4, QueueOptions{ .scheduling = Scheduling::work_stealing });
+//}
+//
+//TEST_CASE(wait_for_dependency, "a task waits for a task which depends on a task enqueued after the waiting one") {
+//    Queue queue;
+//
+//    std::atomic<std::size_t> steps{ 0 };
+//    std::size_t seen{ 0 };
+//
+//    // The waiting task runs first, the waited one writes after the second one, so the only worker
+//    //  has to run the second task while waiting.
+//    queue.enqueue([&queue, &steps, &seen]() {
+//        auto handle = queue.enqueue_with_handle([&steps]() {
+//            return steps.fetch_add(1) + 1;
+//            }, writes(1), reads());
+//        seen = handle.get();
+//        }, writes(), reads());
+//
+//    queue.enqueue([&steps]() {
+//        steps++;
+//        }, writes(1), reads());
+//
+//    queue.serve();
+//
+//    if (seen != 2) {
+//        PRINT_INDENTED("The waited task ran as step " << seen << " but step 2 was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(two_waiters, "two worker threads wait for the same handle, both are woken up when it finishes") {
+//    constexpr std::size_t waiters = 2;
+//
+//    Queue queue(QueueOptions{ .worker_threads = waiters + 1 });
+//
+//    std::atomic<bool> slow_done{ false };
+//    std::atomic<std::size_t> woken{ 0 };
+//
+//    auto handle = queue.enqueue_with_handle([&slow_done]() {
+//        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+//        slow_done.store(true);
+//        }, writes(), reads());
+//
+//    // Both waiters park on the handle before the slow task finishes.
+//    for (std::size_t i = 0; i < waiters; ++i) {
+//        queue.enqueue([&handle, &slow_done, &woken]() {
+//            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+//            handle.wait();
+//            if (slow_done.load()) woken++;
+//            }, writes(), reads());
+//    }
+//
+//    queue.wait_idle();
+//
+//    if (woken.load() != waiters) {
+//        PRINT_INDENTED(woken.load() << " of " << waiters << " waiters returned after the waited task finished");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!results()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!exceptions()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wait_in_single_worker()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wait_in_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wait_in_stealing_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wait_for_dependency()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!two_waiters()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
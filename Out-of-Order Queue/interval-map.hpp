@@ -0,0 +1,128 @@
+#ifndef INTERVAL_MAP_HPP
+#define INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <utility>
+
+// Disjoint half-open intervals of keys, each with its own value, keys outside of them have none.
+// An update of a range splits the intervals at its ends, so that every interval is either inside
+//  of it or outside, and the equal neighbours are coalesced afterwards, so a range costs
+//  a lookup and a step per interval it overlaps, however many keys it spans.
+template<class Key, class Value>
+class IntervalMap {
+public:
+    std::size_t size() const noexcept { return segments.size(); }
+    bool empty() const noexcept { return segments.empty(); }
+
+    // Splits the intervals at the ends of the range, both halves keep the value. Fills the gaps
+    //  of the range with default values, then calls visit(value) for the intervals of the range in order.
+    template<class Visit>
+    void update(Key begin, Key end, Visit&& visit);
+
+    // Replaces the intervals of a range that update() has split already by a single one.
+    void assign(Key begin, Key end, Value value);
+
+    // Merges the touching intervals from the one before the range to the one after it,
+    //  whose values are the same by same(a, b).
+    template<class Same>
+    void coalesce(Key begin, Key end, Same&& same);
+
+    // Checks up to the given number of intervals after the ones checked by the previous call,
+    //  wrapping around, and erases those that idle(value) holds for.
+    template<class Idle>
+    void sweep(std::size_t steps, Idle&& idle);
+
+private:
+    struct Segment {
+        Key end;
+        Value value;
+    };
+    using Iterator = typename std::map<Key, Segment>::iterator;
+
+    // Makes an interval start at the key if one spans it, returns the first interval starting at it or after.
+    Iterator split(Key at);
+
+    // Intervals by their first key.
+    std::map<Key, Segment> segments;
+    Key sweep_cursor{};
+};
+
+
+template<class Key, class Value>
+typename IntervalMap<Key, Value>::Iterator IntervalMap<Key, Value>::split(Key at) {
+    const Iterator next = segments.upper_bound(at);
+    if (next == segments.begin()) return next;
+
+    const Iterator spanning = std::prev(next);
+    if (spanning->first == at) return spanning;
+    if (!(at < spanning->second.end)) return next;
+
+    Segment second{ spanning->second.end, spanning->second.value };
+    spanning->second.end = at;
+    return segments.emplace_hint(next, at, std::move(second));
+}
+
+template<class Key, class Value>
+template<class Visit>
+void IntervalMap<Key, Value>::update(Key begin, Key end, Visit&& visit) {
+    if (!(begin < end)) return;
+
+    Iterator it = split(begin);
+    split(end);
+
+    for (Key key = begin; key < end; ++it) {
+        if (it == segments.end() || key < it->first) {
+            const Key gap_end = it == segments.end() || end < it->first ? end : it->first;
+            it = segments.emplace_hint(it, key, Segment{ gap_end, Value{} });
+        }
+        visit(it->second.value);
+        key = it->second.end;
+    }
+}
+
+template<class Key, class Value>
+void IntervalMap<Key, Value>::assign(Key begin, Key end, Value value) {
+    if (!(begin < end)) return;
+
+    const Iterator next = segments.erase(segments.lower_bound(begin), segments.lower_bound(end));
+    segments.emplace_hint(next, begin, Segment{ end, std::move(value) });
+}
+
+template<class Key, class Value>
+template<class Same>
+void IntervalMap<Key, Value>::coalesce(Key begin, Key end, Same&& same) {
+    Iterator it = segments.lower_bound(begin);
+    if (it != segments.begin()) --it;
+    if (it == segments.end()) return;
+
+    for (Iterator next = std::next(it); next != segments.end() && !(end < next->first); next = std::next(it)) {
+        if (!(it->second.end < next->first) && same(std::as_const(it->second.value), std::as_const(next->second.value))) {
+            it->second.end = next->second.end;
+            segments.erase(next);
+        }
+        else {
+            it = next;
+        }
+    }
+}
+
+template<class Key, class Value>
+template<class Idle>
+void IntervalMap<Key, Value>::sweep(std::size_t steps, Idle&& idle) {
+    Iterator it = segments.lower_bound(sweep_cursor);
+    for (; steps > 0 && !segments.empty(); --steps) {
+        if (it == segments.end()) it = segments.begin();
+        if (idle(std::as_const(it->second.value))) {
+            it = segments.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    sweep_cursor = it == segments.end() ? Key{} : it->first;
+}
+
+
+#endif // INTERVAL_MAP_HPP
@@ -0,0 +1,308 @@
+///**
+// * Measures the latency from enqueue() to the start of the task while the workers are idle,
+// *  with the tasks enqueued one at a time with a pause in between, so that the workers always
+// *  have to be found (or woken up) again. Percentiles are printed in microseconds.
+// * The bursts compare threads spawned to serve every burst with the worker threads of the queue.
+// * The backlog case measures the same latency for interactive tasks enqueued behind a deep
+// *  backlog of bulk tasks, with the same priority as the bulk and with a higher one.
+// * The chain measures the time per link of a long chain of writes to one resource, with the released
+// *  task always pushed to the ready queue and with it run by the same worker right away.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <algorithm>
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    struct Configuration {
+//        const char* name;
+//        QueueOptions options;
+//    };
+//
+//    const Configuration configurations[] = {
+//        { "park right away", QueueOptions{ .max_spin_rounds = 0 } },
+//        { "spin then park", QueueOptions{} },
+//        { "lock-free ready queue, park right away", QueueOptions{ .ready_queue_capacity = 1024, .max_spin_rounds = 0 } },
+//        { "lock-free ready queue, spin then park", QueueOptions{ .ready_queue_capacity = 1024 } },
+//    };
+//
+//    double percentile(std::vector<double>& sorted, double p) {
+//        const std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())));
+//        return sorted[index];
+//    }
+//
+//} // namespace
+//
+//// The samples are enqueued by a task, so that the queue does not run empty and the workers stay in serve().
+//static bool latency_benchmark(std::size_t workers, std::chrono::microseconds pause) {
+//    constexpr std::size_t samples = 2'000;
+//
+//    for (const Configuration& configuration : configurations) {
+//        Queue queue(configuration.options);
+//
+//        std::vector<double> latencies(samples);
+//        std::atomic<std::size_t> done_samples{ 0 };
+//
+//        queue.enqueue([&]() {
+//            for (std::size_t i = 0; i < samples; ++i) {
+//                const auto enqueued = std::chrono::steady_clock::now();
+//                queue.enqueue([&latencies, &done_samples, enqueued, i]() {
+//                    const std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - enqueued;
+//                    latencies[i] = latency.count();
+//                    done_samples.fetch_add(1, std::memory_order_release);
+//                    }, writes(), reads());
+//
+//                // The next sample starts only once the others are idle again.
+//                while (done_samples.load(std::memory_order_acquire) <= i) {
+//                    std::this_thread::yield();
+//                }
+//                std::this_thread::sleep_for(pause);
+//            }
+//            }, writes(), reads());
+//
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&queue]() {
+//                queue.serve();
+//                });
+//        }
+//
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        if (done_samples.load() != samples) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << samples << " but got " << done_samples.load());
+//            return false;
+//        }
+//
+//        std::sort(latencies.begin(), latencies.end());
+//        PRINT_INDENTED(configuration.name << ": p50 " << percentile(latencies, 0.5) << " us, p99 " << percentile(latencies, 0.99) << " us");
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(short_pauses, "4 workers, tasks enqueued 20 us apart") {
+//    return latency_benchmark(4, std::chrono::microseconds(20));
+//}
+//
+//TEST_CASE(long_pauses, "4 workers, tasks enqueued 1 ms apart") {
+//    return latency_benchmark(4, std::chrono::microseconds(1'000));
+//}
+//
+//// Time from the start of a burst of tiny tasks until all of them have finished.
+//TEST_CASE(bursts, "4 workers, bursts of 16 tasks, threads spawned for every burst or owned by the queue") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t bursts = 1'000;
+//    constexpr std::size_t tasks = 16;
+//
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//    const auto enqueue_burst = [&done_tasks](Queue& queue) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                done_tasks.fetch_add(1, std::memory_order_relaxed);
+//                }, writes(), reads());
+//        }
+//        };
+//
+//    Queue served_queue;
+//    const auto spawn_start = std::chrono::steady_clock::now();
+//
+//    for (std::size_t b = 0; b < bursts; ++b) {
+//        enqueue_burst(served_queue);
+//
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&served_queue]() {
+//                served_queue.serve();
+//                });
+//        }
+//
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//    }
+//
+//    const std::chrono::duration<double, std::micro> spawn_elapsed = std::chrono::steady_clock::now() - spawn_start;
+//
+//    Queue pool_queue(QueueOptions{ .worker_threads = workers });
+//    const auto pool_start = std::chrono::steady_clock::now();
+//
+//    for (std::size_t b = 0; b < bursts; ++b) {
+//        enqueue_burst(pool_queue);
+//        pool_queue.wait_idle();
+//    }
+//
+//    const std::chrono::duration<double, std::micro> pool_elapsed = std::chrono::steady_clock::now() - pool_start;
+//
+//    if (done_tasks.load() != 2 * bursts * tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << 2 * bursts * tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    PRINT_INDENTED("threads spawned per burst: " << spawn_elapsed.count() / bursts << " us per burst");
+//    PRINT_INDENTED("worker threads of the queue: " << pool_elapsed.count() / bursts << " us per burst");
+//    return true;
+//}
+//
+//// The bulk tasks keep the workers busy all the time, a few thousand of them are always waiting.
+//TEST_CASE(deep_backlog, "4 workers, interactive tasks 200 us apart behind 5000 bulk tasks of 5 us") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t samples = 200;
+//    constexpr std::size_t backlog = 5'000;
+//    constexpr auto bulk_work = std::chrono::microseconds(5);
+//    constexpr auto pause = std::chrono::microseconds(200);
+//
+//    for (const Priority priority : { Priority::normal, Priority::high }) {
+//        Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//        std::vector<double> latencies(samples);
+//        std::atomic<std::size_t> done_samples{ 0 };
+//        std::atomic<std::size_t> pending_bulk{ 0 };
+//
+//        const auto enqueue_bulk = [&queue, &pending_bulk, bulk_work](std::size_t count) {
+//            pending_bulk.fetch_add(count, std::memory_order_relaxed);
+//            for (std::size_t i = 0; i < count; ++i) {
+//                queue.enqueue([&pending_bulk, bulk_work]() {
+//                    const auto end = std::chrono::steady_clock::now() + bulk_work;
+//                    while (std::chrono::steady_clock::now() < end) {}
+//                    pending_bulk.fetch_sub(1, std::memory_order_relaxed);
+//                    }, writes(), reads(), Priority::normal);
+//            }
+//            };
+//
+//        enqueue_bulk(backlog);
+//
+//        for (std::size_t i = 0; i < samples; ++i) {
+//            const std::size_t pending = pending_bulk.load(std::memory_order_relaxed);
+//            if (pending < backlog) enqueue_bulk(backlog - pending);
+//
+//            const auto enqueued = std::chrono::steady_clock::now();
+//            queue.enqueue([&latencies, &done_samples, enqueued, i]() {
+//                const std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - enqueued;
+//                latencies[i] = latency.count();
+//                done_samples.fetch_add(1, std::memory_order_release);
+//                }, writes(), reads(), priority);
+//
+//            std::this_thread::sleep_for(pause);
+//        }
+//
+//        queue.wait_idle();
+//
+//        if (done_samples.load() != samples) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << samples << " but got " << done_samples.load());
+//            return false;
+//        }
+//
+//        std::sort(latencies.begin(), latencies.end());
+//        PRINT_INDENTED((priority == Priority::normal ? "same priority as the bulk" : "high priority")
+//            << ": p50 " << percentile(latencies, 0.5) << " us, p99 " << percentile(latencies, 0.99) << " us");
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(chain, "4 workers, a chain of 1M tasks writing one resource") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 1'000'000;
+//
+//    const Configuration chain_configurations[] = {
+//        { "pushed to the ready queue", QueueOptions{ .max_continuations = 0 } },
+//        { "run as continuations", QueueOptions{} },
+//        { "pushed to the worker deque", QueueOptions{ .scheduling = Scheduling::work_stealing, .max_continuations = 0 } },
+//        { "run as continuations of work stealing workers", QueueOptions{ .scheduling = Scheduling::work_stealing } },
+//    };
+//
+//    for (const Configuration& configuration : chain_configurations) {
+//        Queue queue(configuration.options);
+//        std::size_t value{ 0 };
+//
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&value]() {
+//                ++value;
+//                }, writes(0), reads());
+//        }
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&queue]() {
+//                queue.serve();
+//                });
+//        }
+//
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+//
+//        if (value != tasks) {
+//            PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << value);
+//            return false;
+//        }
+//
+//        PRINT_INDENTED(configuration.name << ": " << elapsed.count() / tasks << " ns per link");
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!short_pauses()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!long_pauses()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!bursts()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!deep_backlog()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!chain()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
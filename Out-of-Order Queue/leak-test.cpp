@@ -5,6 +5,7 @@
 //
 //#include <cstddef>
 //
+//#include <algorithm>
 //#include <iostream>
 //#include <utility>
 //
@@ -132,6 +133,43 @@
 //    return true;
 //}
 //
+//TEST_CASE(many_resources, "serve many rounds of tasks on ever new resources with one queue") {
+//    constexpr std::size_t rounds = 1'000;
+//    constexpr std::size_t tasks_per_round = 1'000;
+//    // Entries of finished rounds are swept while the next ones are enqueued, only a few rounds may stay.
+//    constexpr std::size_t max_tracked = 4 * tasks_per_round;
+//
+//    std::size_t done_tasks{ 0 };
+//    std::size_t peak_tracked{ 0 };
+//
+//    Queue queue;
+//
+//    for (std::size_t round = 0; round < rounds; ++round) {
+//        for (std::size_t i = 0; i < tasks_per_round; ++i) {
+//            // Address-like ids that are never reused, every task writes one and reads the previous one.
+//            const resource_id resource = (round * tasks_per_round + i + 1) * 64;
+//            queue.enqueue([&done_tasks]() {
+//                ++done_tasks;
+//                }, writes(resource), reads(resource - 64));
+//        }
+//
+//        queue.serve();
+//        peak_tracked = std::max(peak_tracked, queue.tracked_resources());
+//    }
+//
+//    if (done_tasks != rounds * tasks_per_round) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << rounds * tasks_per_round << " but got " << done_tasks);
+//        return false;
+//    }
+//
+//    if (peak_tracked > max_tracked) {
+//        PRINT_INDENTED("The resource tables keep growing, tracked " << peak_tracked << " resources but expected at most " << max_tracked);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
 //int main() {
 //    std::size_t failed = 0;
 //    std::size_t total = 0;
@@ -157,6 +195,11 @@
 //        ++failed;
 //    }
 //
+//    ++total;
+//    if (!many_resources()) {
+//        ++failed;
+//    }
+//
 //    RESET_INDENT();
 //    PRINT_INDENTED();
 //
@@ -0,0 +1,116 @@
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+inline constexpr std::size_t cache_line_size = 64;
+
+// Bounded lock-free multi-producer multi-consumer FIFO (Vyukov's array queue).
+// Every cell carries a sequence number telling producers and consumers whose turn it is,
+//  so each side only needs a single CAS on its own position counter.
+template<class T>
+class BoundedMpmcQueue {
+public:
+    // The capacity is rounded up to the next power of two.
+    explicit BoundedMpmcQueue(std::size_t capacity);
+    ~BoundedMpmcQueue();
+
+    BoundedMpmcQueue(const BoundedMpmcQueue&) = delete;
+    BoundedMpmcQueue& operator=(const BoundedMpmcQueue&) = delete;
+
+    // Returns false if the queue is full, the value is left untouched in that case.
+    bool try_push(T&& value);
+
+    // Returns false if the queue is empty.
+    bool try_pop(T& value);
+
+    std::size_t capacity() const noexcept { return mask + 1; }
+
+    // Only a hint, the value may be stale by the time it is returned.
+    bool empty() const noexcept {
+        return dequeue_pos.load(std::memory_order_relaxed) >= enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos{ 0 };
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos{ 0 };
+};
+
+
+template<class T>
+BoundedMpmcQueue<T>::BoundedMpmcQueue(std::size_t capacity)
+    : cells(std::make_unique<Cell[]>(std::bit_ceil(capacity < 2 ? std::size_t{ 2 } : capacity))),
+    mask(std::bit_ceil(capacity < 2 ? std::size_t{ 2 } : capacity) - 1) {
+    for (std::size_t i = 0; i <= mask; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+BoundedMpmcQueue<T>::~BoundedMpmcQueue() {
+    T value;
+    while (try_pop(value)) {}
+}
+
+template<class T>
+bool BoundedMpmcQueue<T>::try_push(T&& value) {
+    Cell* cell;
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+        cell = &cells[pos & mask];
+        const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false;
+        else pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    ::new (static_cast<void*>(cell->storage)) T(std::move(value));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool BoundedMpmcQueue<T>::try_pop(T& value) {
+    Cell* cell;
+    std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+        cell = &cells[pos & mask];
+        const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+
+        if (diff == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false;
+        else pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    T* stored = std::launder(reinterpret_cast<T*>(cell->storage));
+    value = std::move(*stored);
+    stored->~T();
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+
+#endif // MPMC_QUEUE_HPP
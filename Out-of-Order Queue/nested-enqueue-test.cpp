@@ -0,0 +1,191 @@
+///**
+// * Tests the tasks enqueued from inside tasks when the queue defers them until the enqueuing
+// *  task finishes: all of them run, the resources still order them, and waiting through a handle
+// *  does not depend on the enqueuing task finishing first.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    constexpr QueueOptions deferring{ .defer_nested_enqueues = true };
+//
+//    // Every task enqueues fan_out children until the given depth, the children of one task
+//    //  all add to the slot of their parent, the others only read it.
+//    void spawn(Queue& queue, std::vector<std::size_t>& slots, std::atomic<std::size_t>& done_tasks,
+//        std::size_t slot, std::size_t depth, std::size_t fan_out) {
+//        done_tasks.fetch_add(1, std::memory_order_relaxed);
+//        if (depth == 0) return;
+//
+//        for (std::size_t i = 0; i < fan_out; ++i) {
+//            const std::size_t child = slot * fan_out + i + 1;
+//            queue.enqueue([&queue, &slots, &done_tasks, slot, child, depth, fan_out]() {
+//                slots[slot] += slots[child] + 1;
+//                spawn(queue, slots, done_tasks, child, depth - 1, fan_out);
+//                }, writes(slot), reads(child));
+//        }
+//    }
+//
+//} // namespace
+//
+//static bool fan_out_test(QueueOptions options) {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t depth = 6;
+//    constexpr std::size_t fan_out = 6;
+//
+//    Queue queue(options);
+//
+//    std::size_t expected_tasks = 0;
+//    for (std::size_t level = 0, width = 1; level <= depth; ++level, width *= fan_out) expected_tasks += width;
+//
+//    std::vector<std::size_t> slots(expected_tasks, 0);
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//
+//    queue.enqueue([&]() {
+//        spawn(queue, slots, done_tasks, 0, depth, fan_out);
+//        }, writes(), reads());
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (done_tasks.load() != expected_tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << expected_tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    // Every child adds to its parent before it has children of its own, so each slot counts its direct children.
+//    for (std::size_t slot = 0; slot < expected_tasks; ++slot) {
+//        const std::size_t expected = slot * fan_out + 1 < expected_tasks ? fan_out : 0;
+//        if (slots[slot] != expected) {
+//            PRINT_INDENTED("Slot " << slot << " holds " << slots[slot] << " but " << expected << " was expected");
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(fan_out, "a tree of tasks enqueuing their children, served by multiple workers") {
+//    return fan_out_test(deferring);
+//}
+//
+//TEST_CASE(fan_out_stealing, "a tree of tasks enqueuing their children, served by multiple work stealing workers") {
+//    return fan_out_test(QueueOptions{ .scheduling = Scheduling::work_stealing, .defer_nested_enqueues = true });
+//}
+//
+//TEST_CASE(children_after_parent, "the children only start once the task which enqueued them has finished") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t children = 16;
+//
+//    Queue queue(QueueOptions{ .defer_nested_enqueues = true, .worker_threads = workers });
+//
+//    std::atomic<bool> parent_done{ false };
+//    std::atomic<std::size_t> early_children{ 0 };
+//    std::atomic<std::size_t> done_children{ 0 };
+//
+//    queue.enqueue([&]() {
+//        for (std::size_t i = 0; i < children; ++i) {
+//            queue.enqueue([&]() {
+//                if (!parent_done.load()) early_children++;
+//                done_children++;
+//                }, writes(), reads());
+//        }
+//        // The other workers are idle, they would pick the children up by now.
+//        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+//        parent_done.store(true);
+//        }, writes(), reads());
+//
+//    queue.wait_idle();
+//
+//    if (done_children.load() != children || early_children.load() != 0) {
+//        PRINT_INDENTED(done_children.load() << " children ran, " << early_children.load() << " of them before their parent finished, expected "
+//            << children << " and none");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(wait_for_deferred, "a task waits for the handle of a task it has just enqueued") {
+//    constexpr std::size_t workers = 2;
+//    constexpr std::size_t tasks = 100;
+//
+//    Queue queue(QueueOptions{ .defer_nested_enqueues = true, .worker_threads = workers });
+//
+//    std::atomic<std::size_t> sum{ 0 };
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&queue, &sum, i]() {
+//            auto handle = queue.enqueue_with_handle([i]() {
+//                return i;
+//                }, writes(i % 4), reads());
+//            sum += handle.get();
+//            }, writes(), reads());
+//    }
+//
+//    queue.wait_idle();
+//
+//    const std::size_t expected = tasks * (tasks - 1) / 2;
+//    if (sum.load() != expected) {
+//        PRINT_INDENTED("The waited tasks returned " << sum.load() << " in total but " << expected << " was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!fan_out()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!fan_out_stealing()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!children_after_parent()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wait_for_deferred()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
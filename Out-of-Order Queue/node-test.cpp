@@ -0,0 +1,248 @@
+///**
+// * Tests the resource nodes: a task accessing a node is ordered with the tasks accessing the nodes
+// *  above and below it, as if it accessed the whole subtree, while the tasks on disjoint subtrees
+// *  still run in parallel.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <iostream>
+//#include <random>
+//#include <stdexcept>
+//#include <string>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//TEST_CASE(scene_order, "tasks on a scene, its objects and their components run in the order of their conflicts") {
+//    Queue queue;
+//    std::string log;
+//
+//    const resource_node scene = queue.add_resource_node();
+//    const resource_node first = queue.add_resource_node(scene);
+//    const resource_node second = queue.add_resource_node(scene);
+//    const resource_node component = queue.add_resource_node(first);
+//
+//    queue.enqueue([&log]() { log += "a"; }, writes(component), reads());
+//    queue.enqueue([&log]() { log += "b"; }, writes(), reads(scene));
+//    queue.enqueue([&log]() { log += "c"; }, writes(second), reads());
+//    queue.enqueue([&log]() { log += "d"; }, writes(), reads(first));
+//    queue.enqueue([&log]() { log += "e"; }, writes(scene), reads());
+//    queue.enqueue([&log]() { log += "f"; }, writes(), reads(component));
+//
+//    // The scene is read after the component was written, and the second object is written
+//    //  after the scene was read, the last task reads what the scene writer wrote.
+//    queue.serve();
+//
+//    if (log != "abdcef" && log != "abcdef") {
+//        PRINT_INDENTED("The tasks ran in the order \"" << log << "\"");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(siblings_in_parallel, "writers of two children of a node and readers of a node and of its child run at the same time") {
+//    Queue queue(QueueOptions{ .worker_threads = 2 });
+//
+//    const resource_node parent = queue.add_resource_node();
+//    const resource_node left = queue.add_resource_node(parent);
+//    const resource_node right = queue.add_resource_node(parent);
+//
+//    // Each task of a pair waits for the other one to start, they would never finish one after the other.
+//    const auto pair = [&queue](auto first_writes, auto first_reads, auto second_writes, auto second_reads) {
+//        std::atomic<std::size_t> started{ 0 };
+//        const auto task = [&started]() {
+//            started++;
+//            while (started.load() < 2) std::this_thread::yield();
+//            };
+//
+//        queue.enqueue(task, first_writes, first_reads);
+//        queue.enqueue(task, second_writes, second_reads);
+//        queue.wait_idle();
+//        };
+//
+//    pair(writes(left), reads(), writes(right), reads());
+//    pair(writes(), reads(parent), writes(), reads(left));
+//    pair(writes(left), reads(), writes(), reads(right));
+//
+//    return true;
+//}
+//
+//namespace {
+//
+//    // A complete tree, the leaves count the writes of the tasks that reached them.
+//    struct Tree {
+//        static constexpr std::size_t fan_out = 4;
+//        static constexpr std::size_t depth = 3;
+//
+//        std::vector<resource_node> nodes;
+//        // The first and one past the last leaf below every node.
+//        std::vector<std::pair<std::size_t, std::size_t>> leaves;
+//        std::size_t leaf_count = 0;
+//
+//        explicit Tree(Queue& queue) {
+//            build(queue, nullptr, 0);
+//        }
+//
+//        void build(Queue& queue, const resource_node* parent, std::size_t level) {
+//            const std::size_t index = nodes.size();
+//            nodes.push_back(parent ? queue.add_resource_node(*parent) : queue.add_resource_node());
+//            leaves.emplace_back(leaf_count, leaf_count);
+//
+//            if (level == depth) {
+//                leaves[index].second = ++leaf_count;
+//                return;
+//            }
+//            const resource_node node = nodes[index];
+//            for (std::size_t i = 0; i < fan_out; ++i) build(queue, &node, level + 1);
+//            leaves[index].second = leaf_count;
+//        }
+//    };
+//
+//} // namespace
+//
+//static bool random_nodes_test(QueueOptions options, std::size_t workers) {
+//    constexpr std::size_t tasks = 20'000;
+//
+//    Queue queue(options);
+//    const Tree tree(queue);
+//
+//    std::vector<std::size_t> values(tree.leaf_count, 0);
+//    std::vector<std::size_t> expected(tree.leaf_count, 0);
+//    std::atomic<std::size_t> errors{ 0 };
+//    std::mt19937 random(7);
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        const std::size_t written = random() % tree.nodes.size();
+//        const std::size_t read = random() % tree.nodes.size();
+//        const auto [write_begin, write_end] = tree.leaves[written];
+//        const auto [read_begin, read_end] = tree.leaves[read];
+//
+//        // The task may write a part of what it reads, those leaves are checked before its writes.
+//        std::vector<std::size_t> seen(expected.begin() + read_begin, expected.begin() + read_end);
+//        for (std::size_t l = write_begin; l < write_end; ++l) expected[l]++;
+//
+//        queue.enqueue([&values, &errors, read_begin, read_end, write_begin, write_end, seen = std::move(seen)]() {
+//            for (std::size_t l = read_begin; l < read_end; ++l) {
+//                if (values[l] != seen[l - read_begin]) errors++;
+//            }
+//            for (std::size_t l = write_begin; l < write_end; ++l) values[l]++;
+//            }, writes(tree.nodes[written]), reads(tree.nodes[read]));
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (errors.load() != 0) {
+//        PRINT_INDENTED(errors.load() << " reads of a leaf saw another number of writes than was enqueued before them");
+//        return false;
+//    }
+//    if (values != expected) {
+//        PRINT_INDENTED("The leaves were not written the expected number of times");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(random_nodes, "nodes of a tree written and read at random, served by a single worker") {
+//    return random_nodes_test(QueueOptions{}, 1);
+//}
+//
+//TEST_CASE(random_nodes_in_workers, "nodes of a tree written and read at random, served by multiple workers") {
+//    return random_nodes_test(QueueOptions{}, 4);
+//}
+//
+//TEST_CASE(random_nodes_stealing, "nodes of a tree written and read at random, served by multiple work stealing workers") {
+//    return random_nodes_test(QueueOptions{ .scheduling = Scheduling::work_stealing }, 4);
+//}
+//
+//TEST_CASE(unknown_parent, "a parent that is not a node of the queue is rejected, and no node is added") {
+//    Queue queue;
+//
+//    const resource_node root = queue.add_resource_node();
+//
+//    for (const resource_node parent : { resource_node{ 1 }, resource_node{ 1'000 } }) {
+//        try {
+//            queue.add_resource_node(parent);
+//            PRINT_INDENTED("Adding a node below the unknown node " << parent.index << " did not throw");
+//            return false;
+//        }
+//        catch (const std::out_of_range&) {
+//        }
+//    }
+//
+//    // The next node takes the index after the root, so the rejected ones were not added.
+//    const resource_node child = queue.add_resource_node(root);
+//    if (child.index != root.index + 1) {
+//        PRINT_INDENTED("The child got the index " << child.index << ", expected " << root.index + 1);
+//        return false;
+//    }
+//
+//    std::size_t runs{ 0 };
+//    queue.enqueue([&runs]() { ++runs; }, writes(child), reads());
+//    queue.serve();
+//
+//    return runs == 1;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!scene_order()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!siblings_in_parallel()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_nodes()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_nodes_in_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_nodes_stealing()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!unknown_parent()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
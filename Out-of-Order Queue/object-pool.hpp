@@ -0,0 +1,122 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+
+// Recycling pool of default-constructed objects, allocated in slabs and never destroyed.
+// A released object is handed out again as is, resetting its state is left to the caller.
+// Every thread keeps a small free list of its own and exchanges objects with a shared list
+//  in batches, so the steady state neither allocates nor takes the shared lock for every object.
+// T has to provide a `T* pool_next` member, it is only used while the object sits in the pool.
+template<class T>
+class ObjectPool {
+public:
+    static T* acquire();
+    static void release(T* object);
+
+private:
+    static constexpr std::size_t slab_size = 64;
+    static constexpr std::size_t batch_size = 32;
+    static constexpr std::size_t max_local_size = 4 * batch_size;
+
+    struct SharedList {
+        std::mutex mtx;
+        T* head = nullptr;
+        std::size_t size = 0;
+    };
+
+    struct LocalList {
+        T* head = nullptr;
+        std::size_t size = 0;
+
+        // Hands the objects back when the thread exits, so that they are not lost.
+        ~LocalList();
+    };
+
+    // Intentionally leaked, objects may still be released from thread-local destructors at exit.
+    static SharedList& shared() {
+        static SharedList* list = new SharedList;
+        return *list;
+    }
+
+    static LocalList& local() {
+        static thread_local LocalList list;
+        return list;
+    }
+
+    // Moves up to count objects from the front of the list to the front of the other one.
+    static std::size_t move_batch(T*& from, T*& to, std::size_t count);
+};
+
+
+template<class T>
+ObjectPool<T>::LocalList::~LocalList() {
+    SharedList& list = shared();
+    std::lock_guard<std::mutex> guard(list.mtx);
+    list.size += move_batch(head, list.head, size);
+    size = 0;
+}
+
+template<class T>
+std::size_t ObjectPool<T>::move_batch(T*& from, T*& to, std::size_t count) {
+    std::size_t moved = 0;
+    for (; moved < count && from; ++moved) {
+        T* object = from;
+        from = object->pool_next;
+        object->pool_next = to;
+        to = object;
+    }
+    return moved;
+}
+
+template<class T>
+T* ObjectPool<T>::acquire() {
+    LocalList& list = local();
+
+    if (!list.head) {
+        SharedList& shared_list = shared();
+        std::lock_guard<std::mutex> guard(shared_list.mtx);
+
+        if (!shared_list.head) {
+            T* slab = new T[slab_size];
+            for (std::size_t i = 0; i < slab_size; ++i) {
+                slab[i].pool_next = shared_list.head;
+                shared_list.head = &slab[i];
+            }
+            shared_list.size += slab_size;
+        }
+
+        const std::size_t moved = move_batch(shared_list.head, list.head, batch_size);
+        shared_list.size -= moved;
+        list.size += moved;
+    }
+
+    T* object = list.head;
+    list.head = object->pool_next;
+    list.size--;
+    object->pool_next = nullptr;
+    return object;
+}
+
+template<class T>
+void ObjectPool<T>::release(T* object) {
+    LocalList& list = local();
+
+    object->pool_next = list.head;
+    list.head = object;
+    list.size++;
+
+    // Threads that only consume tasks would hoard them, give a batch back to the others.
+    if (list.size > max_local_size) {
+        SharedList& shared_list = shared();
+        std::lock_guard<std::mutex> guard(shared_list.mtx);
+
+        const std::size_t moved = move_batch(list.head, shared_list.head, batch_size);
+        list.size -= moved;
+        shared_list.size += moved;
+    }
+}
+
+
+#endif // OBJECT_POOL_HPP
@@ -0,0 +1,327 @@
+///**
+// * Tests the worker threads owned by the queue, the tasks are enqueued in bursts
+// *  and nobody but the pool serves them.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <mutex>
+//#include <set>
+//#include <stdexcept>
+//#include <string>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//TEST_CASE(bursts, "enqueue bursts of tasks and wait for each of them, the same threads serve all of them") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t bursts = 100;
+//    constexpr std::size_t tasks = 100;
+//
+//    Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//    std::mutex ids_mtx;
+//    std::set<std::thread::id> ids;
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//
+//    for (std::size_t b = 0; b < bursts; ++b) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&]() {
+//                {
+//                    std::lock_guard<std::mutex> guard(ids_mtx);
+//                    ids.insert(std::this_thread::get_id());
+//                }
+//                done_tasks++;
+//                }, writes(), reads());
+//        }
+//
+//        queue.wait_idle();
+//
+//        if (done_tasks.load() != (b + 1) * tasks) {
+//            PRINT_INDENTED("Burst " << b << " was not finished by wait_idle(), expected " << (b + 1) * tasks << " tasks but got " << done_tasks.load());
+//            return false;
+//        }
+//    }
+//
+//    if (ids.size() > workers || ids.count(std::this_thread::get_id()) != 0) {
+//        PRINT_INDENTED("Tasks were served by " << ids.size() << " threads, expected at most the " << workers << " worker threads");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(dependencies_across_bursts, "tasks of a burst depend on the tasks of the previous one") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t bursts = 50;
+//    constexpr std::size_t resources = 8;
+//
+//    Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//    std::vector<std::size_t> values(resources, 0);
+//
+//    for (std::size_t b = 0; b < bursts; ++b) {
+//        for (std::size_t r = 0; r < resources; ++r) {
+//            queue.enqueue([&values, r]() {
+//                std::this_thread::sleep_for(std::chrono::microseconds(100));
+//                values[r] = values[r] * 2 + 1;
+//                }, writes(r), reads());
+//        }
+//
+//        // Only every other burst waits, so that the next one is enqueued while the previous runs.
+//        if (b % 2 == 1) {
+//            queue.wait_idle();
+//        }
+//    }
+//
+//    queue.wait_idle();
+//
+//    const std::size_t expected = (std::size_t{ 1 } << bursts) - 1;
+//    for (std::size_t r = 0; r < resources; ++r) {
+//        if (values[r] != expected) {
+//            PRINT_INDENTED("Resource " << r << " was written out of order, expected " << expected << " but got " << values[r]);
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(shutdown_drains, "shutdown() lets the worker threads finish the enqueued tasks") {
+//    constexpr std::size_t workers = 2;
+//    constexpr std::size_t tasks = 1'000;
+//
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//
+//    Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&done_tasks]() {
+//            done_tasks++;
+//            }, writes(i % 16), reads());
+//    }
+//
+//    queue.shutdown();
+//
+//    if (done_tasks.load() != tasks) {
+//        PRINT_INDENTED("Tasks were lost by shutdown(), expected " << tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    // Without the worker threads the queue is served the usual way.
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&done_tasks]() {
+//            done_tasks++;
+//            }, writes(i % 16), reads());
+//    }
+//    queue.serve();
+//
+//    if (done_tasks.load() != 2 * tasks) {
+//        PRINT_INDENTED("Tasks enqueued after shutdown() were not served, expected " << 2 * tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(destroy_with_pool, "destroying the queue shuts the worker threads down") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 1'000;
+//
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//
+//    {
+//        Queue queue(QueueOptions{ .scheduling = Scheduling::work_stealing, .worker_threads = workers });
+//
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                done_tasks++;
+//                }, writes(), reads());
+//        }
+//    }
+//
+//    if (done_tasks.load() != tasks) {
+//        PRINT_INDENTED("Tasks were lost by the destructor, expected " << tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(parked_workers_woken, "every burst wakes as many parked workers as it has tasks, all of them meet in their tasks") {
+//    constexpr std::size_t workers = 8;
+//    constexpr std::size_t rounds = 50;
+//    constexpr auto timeout = std::chrono::seconds(2);
+//
+//    // The workers park right away, so each of them has to be woken up by the enqueue.
+//    Queue queue(QueueOptions{ .max_spin_rounds = 0, .worker_threads = workers });
+//
+//    for (std::size_t round = 0; round < rounds; ++round) {
+//        const std::size_t tasks = round % workers + 1;
+//        std::atomic<std::size_t> started{ 0 };
+//        std::atomic<std::size_t> met{ 0 };
+//
+//        // A task only finishes once all of the burst are running, so they need a worker each.
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&started, &met, tasks, timeout]() {
+//                started++;
+//                const auto deadline = std::chrono::steady_clock::now() + timeout;
+//                while (started.load() < tasks && std::chrono::steady_clock::now() < deadline) {
+//                    std::this_thread::yield();
+//                }
+//                if (started.load() == tasks) met++;
+//                }, writes(), reads());
+//        }
+//
+//        queue.wait_idle();
+//
+//        if (met.load() != tasks) {
+//            PRINT_INDENTED("Only " << met.load() << " of the " << tasks << " tasks of round " << round << " ran at the same time");
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(worker_exceptions, "an exception thrown by a task on a worker thread is rethrown by wait_idle() and shutdown(), the dependents still run") {
+//    constexpr std::size_t workers = 2;
+//    constexpr std::size_t tasks = 100;
+//
+//    std::atomic<std::size_t> done_tasks{ 0 };
+//
+//    Queue queue(QueueOptions{ .worker_threads = workers });
+//
+//    // Both throwing tasks write the resource, only the first one is kept.
+//    queue.enqueue([]() { throw std::runtime_error("first"); }, writes(0), reads());
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&done_tasks]() {
+//            done_tasks++;
+//            }, writes(0), reads());
+//    }
+//    queue.enqueue([]() { throw std::runtime_error("second"); }, writes(0), reads());
+//
+//    std::string rethrown;
+//    try {
+//        queue.wait_idle();
+//    }
+//    catch (const std::runtime_error& error) {
+//        rethrown = error.what();
+//    }
+//
+//    if (rethrown != "first") {
+//        PRINT_INDENTED("wait_idle() rethrew \"" << rethrown << "\", expected the exception of the first task");
+//        return false;
+//    }
+//    if (done_tasks.load() != tasks) {
+//        PRINT_INDENTED("The dependents of the throwing task did not all run, expected " << tasks << " but got " << done_tasks.load());
+//        return false;
+//    }
+//
+//    // The exception is only rethrown once.
+//    queue.wait_idle();
+//
+//    queue.enqueue([]() { throw std::runtime_error("third"); }, writes(), reads());
+//    try {
+//        queue.shutdown();
+//        PRINT_INDENTED("shutdown() did not rethrow the exception of the task");
+//        return false;
+//    }
+//    catch (const std::runtime_error& error) {
+//        if (std::string(error.what()) != "third") {
+//            PRINT_INDENTED("shutdown() rethrew \"" << error.what() << "\", expected \"third\"");
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(serve_exception, "an exception thrown by a task leaves serve() with the task finished, the next serve() runs its dependents") {
+//    constexpr std::size_t tasks = 100;
+//
+//    std::size_t done_tasks{ 0 };
+//
+//    Queue queue;
+//
+//    queue.enqueue([]() { throw std::runtime_error("task failed"); }, writes(0), reads());
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&done_tasks]() {
+//            done_tasks++;
+//            }, writes(0), reads());
+//    }
+//
+//    try {
+//        queue.serve();
+//        PRINT_INDENTED("serve() did not pass the exception of the task on");
+//        return false;
+//    }
+//    catch (const std::runtime_error&) {
+//    }
+//
+//    queue.serve();
+//
+//    if (done_tasks != tasks) {
+//        PRINT_INDENTED("The dependents of the throwing task did not all run, expected " << tasks << " but got " << done_tasks);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!bursts()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!dependencies_across_bursts()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!shutdown_drains()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!destroy_with_pool()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!parked_workers_woken()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!worker_exceptions()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!serve_exception()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,53 @@
+#ifndef PRIORITY_BANDS_HPP
+#define PRIORITY_BANDS_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "ring-deque.hpp"
+
+// A FIFO for every one of a small fixed number of bands, popped from the highest non-empty one.
+// The non-empty bands are kept in a bit mask, so both push and pop are O(1).
+template<class T, std::size_t Bands>
+class PriorityBands {
+    static_assert(Bands > 0 && Bands <= 32);
+
+public:
+    bool empty() const noexcept { return occupied == 0; }
+    std::size_t size() const noexcept { return count; }
+
+    // Number of elements in the given band and the ones above it.
+    std::size_t size_from(std::size_t band) const noexcept {
+        std::size_t total = 0;
+        for (; band < Bands; ++band) total += bands[band].size();
+        return total;
+    }
+
+    void push(std::size_t band, T&& value) {
+        bands[band].push_back(std::move(value));
+        occupied |= std::uint32_t{ 1 } << band;
+        ++count;
+    }
+
+    // Pops the oldest element of the highest non-empty band that is not below min_band.
+    bool pop(T& value, std::size_t min_band = 0) {
+        const std::uint32_t candidates = occupied & ~((std::uint32_t{ 1 } << min_band) - 1);
+        if (candidates == 0) return false;
+
+        const std::size_t band = std::bit_width(candidates) - 1;
+        value = bands[band].pop_front();
+        if (bands[band].empty()) occupied &= ~(std::uint32_t{ 1 } << band);
+        --count;
+        return true;
+    }
+
+private:
+    RingDeque<T> bands[Bands];
+    std::uint32_t occupied = 0;
+    std::size_t count = 0;
+};
+
+
+#endif // PRIORITY_BANDS_HPP
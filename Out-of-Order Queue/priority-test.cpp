@@ -0,0 +1,342 @@
+///**
+// * Tests the dispatch order of tasks of different priorities, served by a single worker
+// *  so that the order is deterministic, and the inheritance of the priority by the tasks
+// *  which block a task of a higher priority. The same goes for the critical path scheduling,
+// *  which orders the ready tasks by the chains waiting for them, and for the continuations,
+// *  which run a chain on one worker only for a bounded number of tasks.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <iostream>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//TEST_CASE(bands, "tasks of a higher priority run before the backlog of lower ones") {
+//    constexpr std::size_t backlog = 1'000;
+//
+//    Queue queue;
+//
+//    std::size_t step{ 0 };
+//    std::size_t low_first{ 0 };
+//    std::size_t normal_first{ 0 };
+//    std::size_t high{ 0 };
+//    std::size_t critical{ 0 };
+//
+//    for (std::size_t i = 0; i < backlog; ++i) {
+//        queue.enqueue([&step, &low_first, i]() {
+//            ++step;
+//            if (i == 0) low_first = step;
+//            }, writes(), reads(), Priority::low);
+//        queue.enqueue([&step, &normal_first, i]() {
+//            ++step;
+//            if (i == 0) normal_first = step;
+//            }, writes(), reads());
+//    }
+//    queue.enqueue([&step, &high]() {
+//        high = ++step;
+//        }, writes(), reads(), Priority::high);
+//    queue.enqueue([&step, &critical]() {
+//        critical = ++step;
+//        }, writes(), reads(), Priority::critical);
+//
+//    queue.serve();
+//
+//    if (critical != 1 || high != 2) {
+//        PRINT_INDENTED("The critical task ran as step " << critical << " and the high one as step " << high << ", expected 1 and 2");
+//        return false;
+//    }
+//    if (normal_first != 3 || low_first != backlog + 3) {
+//        PRINT_INDENTED("The first normal task ran as step " << normal_first << " and the first low one as step " << low_first
+//            << ", expected 3 and " << backlog + 3);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(inherit_through_writes, "a high priority task raises the chain of writers it waits for") {
+//    constexpr std::size_t backlog = 1'000;
+//    constexpr std::size_t chain = 5;
+//
+//    Queue queue;
+//
+//    std::size_t step{ 0 };
+//    std::size_t value{ 0 };
+//    std::size_t high{ 0 };
+//
+//    for (std::size_t i = 0; i < backlog; ++i) {
+//        queue.enqueue([&step]() {
+//            ++step;
+//            }, writes(), reads());
+//    }
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([&step, &value]() {
+//            ++step;
+//            ++value;
+//            }, writes(0), reads());
+//    }
+//    queue.enqueue([&step, &value, &high]() {
+//        high = ++step;
+//        if (value != chain) high = 0;
+//        }, writes(0), reads(), Priority::high);
+//
+//    queue.serve();
+//
+//    if (high != chain + 1) {
+//        PRINT_INDENTED("The high priority task ran as step " << high << " but step " << chain + 1 << " was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(inherit_through_reads, "a high priority writer raises all the readers it waits for and their writer") {
+//    constexpr std::size_t backlog = 1'000;
+//    constexpr std::size_t readers = 4;
+//
+//    Queue queue;
+//
+//    std::size_t step{ 0 };
+//    std::size_t done_readers{ 0 };
+//    std::size_t high{ 0 };
+//
+//    for (std::size_t i = 0; i < backlog; ++i) {
+//        queue.enqueue([&step]() {
+//            ++step;
+//            }, writes(), reads());
+//    }
+//    queue.enqueue([&step]() {
+//        ++step;
+//        }, writes(0), reads());
+//    for (std::size_t i = 0; i < readers; ++i) {
+//        queue.enqueue([&step, &done_readers]() {
+//            ++step;
+//            ++done_readers;
+//            }, writes(), reads(0));
+//    }
+//    queue.enqueue([&step, &done_readers, &high]() {
+//        high = ++step;
+//        if (done_readers != readers) high = 0;
+//        }, writes(0), reads(), Priority::high);
+//
+//    queue.serve();
+//
+//    if (high != readers + 2) {
+//        PRINT_INDENTED("The high priority task ran as step " << high << " but step " << readers + 2 << " was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(inherit_queued, "a queued task blocking a critical one is dispatched again at the higher priority, but runs once") {
+//    constexpr std::size_t backlog = 1'000;
+//
+//    Queue queue(QueueOptions{ .scheduling = Scheduling::work_stealing });
+//
+//    std::size_t step{ 0 };
+//    std::size_t blocking{ 0 };
+//    std::size_t blocking_runs{ 0 };
+//    std::size_t critical{ 0 };
+//
+//    // Everything is enqueued from a task, so that the ready tasks go to the deque of the worker.
+//    queue.enqueue([&]() {
+//        for (std::size_t i = 0; i < backlog; ++i) {
+//            queue.enqueue([&step]() {
+//                ++step;
+//                }, writes(), reads());
+//        }
+//        queue.enqueue([&]() {
+//            blocking = ++step;
+//            ++blocking_runs;
+//            }, writes(0), reads());
+//        for (std::size_t i = 0; i < backlog; ++i) {
+//            queue.enqueue([&step]() {
+//                ++step;
+//                }, writes(), reads());
+//        }
+//        queue.enqueue([&]() {
+//            critical = ++step;
+//            }, writes(), reads(0), Priority::critical);
+//        }, writes(), reads());
+//
+//    queue.serve();
+//
+//    if (blocking != 1 || critical != 2 || blocking_runs != 1) {
+//        PRINT_INDENTED("The blocking task ran " << blocking_runs << " times, as step " << blocking << " and the critical one as step " << critical
+//            << ", expected once as step 1 and 2");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(priorities_in_workers, "tasks of all priorities on shared resources are served by multiple workers in the order of their writes") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 20'000;
+//    constexpr std::size_t resources = 8;
+//    constexpr Priority priorities[] = { Priority::low, Priority::normal, Priority::high, Priority::critical };
+//
+//    Queue queue(QueueOptions{ .ready_queue_capacity = 64 });
+//
+//    std::vector<std::size_t> values(resources, 0);
+//    std::vector<std::size_t> expected(resources, 0);
+//    std::atomic<std::size_t> runs{ 0 };
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        const std::size_t r = i % resources;
+//        const std::size_t read = (i * 7 + 3) % resources;
+//        expected[r] = expected[r] * 3 + expected[read] % 5 + 1;
+//
+//        queue.enqueue([&values, &runs, r, read]() {
+//            values[r] = values[r] * 3 + values[read] % 5 + 1;
+//            runs++;
+//            }, writes(r), reads(read), priorities[(i * 13) % 4]);
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (runs.load() != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << runs.load());
+//        return false;
+//    }
+//
+//    for (std::size_t r = 0; r < resources; ++r) {
+//        if (values[r] != expected[r]) {
+//            PRINT_INDENTED("Resource " << r << " was written out of order, expected " << expected[r] << " but got " << values[r]);
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(critical_path_first, "the head of a chain runs before independent tasks enqueued earlier, and so does the rest of the chain") {
+//    constexpr std::size_t independent = 100;
+//    constexpr std::size_t chain = 10;
+//
+//    Queue queue(QueueOptions{ .scheduling = Scheduling::critical_path });
+//
+//    std::size_t step{ 0 };
+//    std::vector<std::size_t> chain_steps;
+//
+//    for (std::size_t i = 0; i < independent; ++i) {
+//        queue.enqueue([&step]() {
+//            ++step;
+//            }, writes(), reads());
+//    }
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([&step, &chain_steps]() {
+//            chain_steps.push_back(++step);
+//            }, writes(0), reads());
+//    }
+//
+//    queue.serve();
+//
+//    // The last task of the chain is no longer ahead of the independent ones.
+//    for (std::size_t i = 0; i + 1 < chain; ++i) {
+//        if (chain_steps[i] != i + 1) {
+//            PRINT_INDENTED("Step " << i << " of the chain ran as step " << chain_steps[i] << " but step " << i + 1 << " was expected");
+//            return false;
+//        }
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(continuations_bounded, "a long chain runs as continuations, but lets a task enqueued after it in once the limit is reached") {
+//    constexpr std::size_t chain = 1'000;
+//    constexpr std::size_t continuations = 16;
+//
+//    Queue queue(QueueOptions{ .max_continuations = continuations });
+//
+//    std::size_t step{ 0 };
+//    std::size_t independent{ 0 };
+//
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([&step]() {
+//            ++step;
+//            }, writes(0), reads());
+//    }
+//    queue.enqueue([&step, &independent]() {
+//        independent = ++step;
+//        }, writes(), reads());
+//
+//    queue.serve();
+//
+//    // The head of the chain and its continuations, then the task that was queued behind the head.
+//    if (independent != continuations + 2) {
+//        PRINT_INDENTED("The independent task ran as step " << independent << " but step " << continuations + 2 << " was expected");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!bands()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!inherit_through_writes()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!inherit_through_reads()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!inherit_queued()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!priorities_in_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!critical_path_first()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!continuations_bounded()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -1,184 +1,2924 @@
 #ifndef QUEUE_HPP
 #define QUEUE_HPP
 
+#include <cstddef>
 #include <cstdint>
-#include <functional>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <unordered_map>
 #include <vector>
-#include <set>
 #include <memory>
 #include <concepts>
+#include <coroutine>
+#include <exception>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <type_traits>
 #include <utility>
+#include <atomic>
+#include <bit>
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <chrono>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "event-ring.hpp"
+#include "flat-map.hpp"
+#include "interval-map.hpp"
+#include "mpmc-queue.hpp"
+#include "object-pool.hpp"
+#include "priority-bands.hpp"
+#include "ring-deque.hpp"
+#include "sorted-ids.hpp"
+#include "task-graph.hpp"
+#include "unique-task.hpp"
 
 using resource_id = std::uintptr_t;
 
-class Queue {
+// The ids from begin up to end, which is not included. Ranges are a space of their own,
+//  they only conflict with the ranges overlapping them, not with the resource_ids listed singly.
+struct resource_range {
+    resource_id begin;
+    resource_id end;
+};
+
+// A resource in the tree of resources of a queue, see BasicQueue::add_resource_node(). Nodes are
+//  a space of their own as well, a task accessing a node accesses all the nodes below it too.
+struct resource_node {
+    std::uint32_t index;
+};
+
+// The resources a task writes or reads: resource ids, resource ranges, or resource nodes.
+template<class Range>
+concept resource_list = std::ranges::input_range<Range>
+&& (std::convertible_to<std::ranges::range_value_t<Range>, resource_id> || std::same_as<std::ranges::range_value_t<Range>, resource_range>
+    || std::same_as<std::ranges::range_value_t<Range>, resource_node>);
+
+// Tasks of the same class are expected to take about the same time, see Scheduling::critical_path.
+using cost_class_id = std::uint8_t;
+
+enum class Scheduling {
+    // Ready tasks go through one queue shared by all the workers.
+    fifo,
+    // Every thread inside serve() owns a deque, tasks it releases or enqueues are pushed
+    //  to it and popped in LIFO order, idle workers steal the oldest tasks of the others.
+    work_stealing,
+    // Ready tasks go through one heap shared by all the workers, the task gating the longest
+    //  chain of dependents first. The chain is measured in the execution times of the cost classes
+    //  of its tasks, which the queue learns while running them.
+    critical_path,
+};
+
+// Ready tasks of a higher priority are dispatched before all the ready tasks of a lower one.
+// A task inherits the priority of every task it blocks, through any number of dependencies.
+enum class Priority : std::uint8_t {
+    low,
+    normal,
+    high,
+    critical,
+};
+
+struct QueueOptions {
+    Scheduling scheduling = Scheduling::fifo;
+
+    // Number of slots of the lock-free ready queue. Zero keeps every ready task in the
+    //  mutex-protected FIFO, otherwise workers dispatch from a lock-free ring and the FIFO
+    //  only takes the overflow when the ring is full. Ignored by critical path scheduling.
+    std::size_t ready_queue_capacity = 0;
+
+    // Number of independently locked partitions of the resource tables, rounded up to
+    //  a power of two and capped at 64. Enqueues touching disjoint shards do not contend.
+    std::size_t resource_shards = 16;
+
+    // Dependents a worker runs at most in a row right after the task that released them, without
+    //  going through the ready queue, when every task released exactly one. Zero pushes all of them.
+    // Long chains keep their worker until the limit, and then let the other ready tasks in.
+    std::size_t max_continuations = 64;
+
+    // Tasks enqueued from inside a task of this queue are recorded right away, but only become
+    //  available to the workers when the enqueuing task finishes, together with the tasks it releases,
+    //  so a fan-out costs one push to the ready queue and one wakeup instead of one per child.
+    // A task must not wait for the tasks it enqueued other than through their handles then.
+    bool defer_nested_enqueues = false;
+
+    // Polling rounds an idle worker spends at most looking for a task before it parks, zero parks
+    //  right away. Every worker adapts its own window up to this bound: it grows when spinning found
+    //  a task and shrinks when the worker had to park anyway. Producers do not wake parked workers
+    //  for the tasks that the spinning ones are going to pick up.
+    std::size_t max_spin_rounds = 256;
+
+    // Number of worker threads owned by the queue. They are started by the constructor, serve
+    //  the tasks as they come, park when there are none, and only exit on shutdown().
+    // An exception thrown by a task on them does not stop them, the task still finishes and the first
+    //  such exception is rethrown by the next wait_idle() or shutdown().
+    // Zero leaves all the serving to the threads calling serve().
+    std::size_t worker_threads = 0;
+
+    // Events every thread keeps for write_trace() with tracing, the oldest ones are overwritten.
+    std::size_t trace_buffer_capacity = 1 << 16;
+};
+
+// Compile-time configuration of a queue, the default one takes any resource ids.
+struct QueueTraits {
+    // Resource ids are hashed into the tables when zero, otherwise they have to be below this
+    //  bound and index a flat array of the states of the resources, allocated up front. Such a state
+    //  is never swept, it keeps its last tasks alive until other ones use the resource.
+    // Enqueuing a task with a bigger id throws std::out_of_range, without enqueuing it.
+    // The duplicates in the resource lists are found in a bitset of the ids then, without sorting them.
+    static constexpr std::size_t dense_resources = 0;
+
+    // Whether the queue counts what it does for stats(), the counters cost nothing at all otherwise.
+    static constexpr bool statistics = false;
+
+    // Whether the threads log the tasks they enqueue and run for write_trace(), nothing is logged otherwise.
+    static constexpr bool tracing = false;
+};
+
+// For small dense ids, from zero up to Resources - 1.
+template<std::size_t Resources, class Base = QueueTraits>
+struct DenseQueueTraits : Base {
+    static constexpr std::size_t dense_resources = Resources;
+};
+
+template<class Base = QueueTraits>
+struct StatisticsQueueTraits : Base {
+    static constexpr bool statistics = true;
+};
+
+template<class Base = QueueTraits>
+struct TracingQueueTraits : Base {
+    static constexpr bool tracing = true;
+};
+
+// Snapshot of a queue with statistics, see BasicQueue::stats().
+struct QueueStats {
+    static constexpr std::size_t latency_buckets = 32;
+
+    // Counted since the queue was created.
+    std::uint64_t tasks_enqueued = 0;
+    std::uint64_t tasks_started = 0;
+    std::uint64_t tasks_completed = 0;
+    std::uint64_t dependency_edges = 0;
+    // Summed over all the threads: the time spent blocked on the lock of the shared ready queue,
+    //  and the time the workers spent parked.
+    std::chrono::nanoseconds lock_wait{ 0 };
+    std::chrono::nanoseconds parked{ 0 };
+    // Started tasks by the time from becoming ready to starting, bucket b counts the latencies from
+    //  2^(b - 1) up to 2^b nanoseconds, the last one all the longer ones as well.
+    std::array<std::uint64_t, latency_buckets> ready_latency{};
+
+    // At the time of the snapshot, the ready tasks do not include the ones in the lock-free ring.
+    std::size_t ready_tasks = 0;
+    std::size_t unfinished_tasks = 0;
+    std::size_t parked_workers = 0;
+};
+
+template<class Traits = QueueTraits>
+class BasicQueue;
+
+using Queue = BasicQueue<>;
+
+template<class Traits>
+class BasicQueue {
 public:
 
     // Performs the initialization of the queue and exits
     // This method is not allowed to block and is not needed to be thread-safe.
-    Queue() = default;
+    BasicQueue() : BasicQueue(QueueOptions{}) {}
+
+    // Same as above, with non-default tuning of the queue internals.
+    explicit BasicQueue(QueueOptions options);
 
-    // Performs cleanup of the queue. Is not needed to be thread-safe.
-    ~Queue() = default; // noexcept by default
+    // Performs cleanup of the queue, shuts the worker threads down first.
+    // Is not needed to be thread-safe.
+    ~BasicQueue();
 
     // Queue is not copyable
-    Queue(const Queue&) = delete;
-    Queue& operator=(const Queue&) = delete;
+    BasicQueue(const BasicQueue&) = delete;
+    BasicQueue& operator=(const BasicQueue&) = delete;
 
 
     // Queue is movable (not required to be thread-safe)
-    Queue(Queue&&) noexcept = default;
-    Queue& operator=(Queue&&) noexcept = default;
+    BasicQueue(BasicQueue&&) noexcept = default;
+    BasicQueue& operator=(BasicQueue&&) noexcept = default;
 
 
+    // Callables up to this size are stored in the task itself, bigger ones are allocated separately.
+    static constexpr std::size_t task_inline_size = 96;
+
     // Enqueues a new task with the given resource dependencies
     //  to be processed by a worker thread when all the resources are available.
+    // The writes and the reads may each list resource ids or resource ranges, a range costs
+    //  about as much as a single id, however many ids it spans.
+    // The task is moved into the queue when passed as an rvalue, so it does not have to be copyable.
+    // Tasks of other than normal priority always go through the shared ready queue, the others
+    //  may also take the worker deques and the lock-free ring.
+    // The cost class is only used by critical path scheduling.
+    // This method is thread-safe and is not allowed to block.
+    template<std::invocable Func, resource_list WRange, resource_list RRange>
+    void enqueue(Func&& task, WRange&& writes, RRange&& reads, Priority priority = Priority::normal, cost_class_id cost_class = 0);
+
+    // Future-like handle of a task, see enqueue_with_handle().
+    template<class T>
+    class TaskHandle;
+
+    // Same as enqueue(), but returns a handle to wait for the task and to take its result.
+    // The result is stored by value, an exception thrown by the task is kept by the handle
+    //  and rethrown from get() instead of leaving serve().
+    // This method is thread-safe and is not allowed to block.
+    template<std::invocable Func, resource_list WRange, resource_list RRange>
+    TaskHandle<std::decay_t<std::invoke_result_t<std::decay_t<Func>&>>> enqueue_with_handle(Func&& task, WRange&& writes, RRange&& reads, Priority priority = Priority::normal, cost_class_id cost_class = 0);
+
+    // Return type of the coroutines enqueued as tasks, see below.
+    class Coroutine;
+
+    // Awaitable returned by acquire().
+    template<class WRange, class RRange>
+    class Acquire;
+
+    // Enqueues a coroutine as a task with the given resource dependencies, the coroutine only
+    //  starts once the task runs. Its body may co_await acquire() to continue with other resources.
+    // This method is thread-safe and is not allowed to block.
+    template<resource_list WRange, resource_list RRange>
+    void enqueue(Coroutine coroutine, WRange&& writes, RRange&& reads, Priority priority = Priority::normal, cost_class_id cost_class = 0);
+
+    // Awaited by a coroutine task of this queue: suspends it without blocking the worker, and resumes it
+    //  on any worker as a new task enqueued at this point with the given resources, and with the priority
+    //  and cost class of the coroutine.
+    // The resources of the coroutine so far are released when it suspends, the ones it still needs have
+    //  to be listed again. Keeping them would deadlock with any task enqueued in the meantime that uses
+    //  both the kept and the acquired ones.
+    template<resource_list WRange, resource_list RRange>
+    Acquire<std::decay_t<WRange>, std::decay_t<RRange>> acquire(WRange&& writes, RRange&& reads);
+
+
+    // Enqueues the tasks of the batch as if enqueue() was called for each of them in order, with the default priority and cost class,
+    //  but takes the locks of the resource tables and wakes the workers only once.
+    // The elements are (callable, writes, reads) triples, tuples or aggregates with three members.
+    // Callables are moved out of containers passed as rvalues and of ranges yielding rvalues,
+    //  otherwise they are copied.
+    // This method is thread-safe and is not allowed to block.
+    template<std::ranges::input_range Batch>
+    void enqueue_batch(Batch&& batch);
+
+    // Enqueues the tasks of the graph, tasks has to yield one callable for every recorded task in their order,
+    //  otherwise none of them is enqueued and std::invalid_argument is thrown.
+    // The graph decides the dependencies instead of the resource tables: the tasks are ordered among
+    //  themselves and after the previous submission of the same graph to this queue, but not with
+    //  the tasks passed to enqueue() or to other graphs, even on the same resources.
+    // Callables are taken the same way as by enqueue_batch(), the tasks have the default priority and cost class.
     // This method is thread-safe and is not allowed to block.
-    template<std::invocable Func, std::ranges::input_range WRange, std::ranges::input_range RRange>
-        requires std::convertible_to<std::ranges::range_value_t<WRange>, resource_id>
-    && std::convertible_to<std::ranges::range_value_t<RRange>, resource_id>
-        void enqueue(Func&& task, WRange&& writes, RRange&& reads);
+    template<std::ranges::input_range Tasks>
+    void submit(const TaskGraph& graph, Tasks&& tasks);
 
 
     // Makes the current thread a worker thread and starts processing tasks
     //  until the queue is empty. The method will exit when the queue is empty and
     //  no tasks are currently being processed.
+    // An exception thrown by a task leaves serve() once the task is finished, its dependents still run.
     // This method is thread-safe and does not return until the queue is empty.
     void serve();
 
+    // Blocks until all the enqueued tasks have finished, without taking part in serving them,
+    //  so the tasks have to be served by the worker threads of the queue or by serve() elsewhere.
+    // Then rethrows the first exception thrown by a task on the worker threads since it was last rethrown.
+    // Must not be called from a task of this queue.
+    // This method is thread-safe.
+    void wait_idle();
+
+    // Lets the worker threads of the queue finish all the enqueued tasks and joins them.
+    // Tasks enqueued afterwards are only run by serve(). Does nothing if there are no worker threads.
+    // Then rethrows the exception kept from the worker threads like wait_idle().
+    // Must not be called from a task of this queue. Is not needed to be thread-safe.
+    void shutdown();
+
+    // Adds a resource to the tree of resources of this queue, as a new root or below the given node
+    //  of this queue. Writing a node conflicts with every access to the nodes below it and reading it
+    //  with every write below it, and the other way round, yet a task accessing a node only costs
+    //  a step per node on its path to the root, however many nodes there are below it.
+    // Nodes are never removed, and are only meant for resources that are not created all the time.
+    // Throws std::out_of_range if the parent is not a node of this queue.
+    // This method is thread-safe.
+    resource_node add_resource_node();
+    resource_node add_resource_node(resource_node parent);
+
+    // Number of resources currently kept in the dependency tables, for monitoring, every interval
+    //  of the resource ranges counts as one, and every dense id or node whose state refers to a task.
+    // Entries of finished tasks are dropped lazily, as new resources are being tracked.
+    // This method is thread-safe.
+    std::size_t tracked_resources() const;
+
+    // Adds up the counters of all the threads, while the queue keeps running. The counters are
+    //  not read at the same instant, so they may be slightly out of step with each other.
+    // This method is thread-safe.
+    QueueStats stats() const requires Traits::statistics;
+
+    // Writes the logged tasks as Chrome trace-event JSON, which Perfetto and chrome://tracing load:
+    //  a slice for every task on the track of the thread that ran it, with the times it waited
+    //  for its dependencies and for a worker, and a flow arrow for every dependency between them.
+    // The logs are not locked, no tasks may be enqueued or run meanwhile, e.g. call it after wait_idle().
+    void write_trace(std::ostream& out) const requires Traits::tracing;
+
 private:
     struct TaskControl;
+    class TaskRef;
+    struct WorkerDeque;
+    struct ParkingSlot;
+    struct ResourceState;
+    struct ResourceShard;
+    struct RangeTable;
+    struct NodeTable;
+    struct ResourceHash;
+    struct BatchBuffers;
+    struct CoroutineStep;
+    struct RankedTask;
+    struct StatsShard;
+    struct TraceEvent;
+    struct TraceBuffer;
+
+    static constexpr std::size_t max_resource_shards = 64;
+    static constexpr std::size_t priority_levels = 4;
+    static constexpr std::size_t cost_classes = std::size_t{ std::numeric_limits<cost_class_id>::max() } + 1;
+    // Nanoseconds a task of a class that has not run yet is assumed to take.
+    static constexpr std::uint64_t default_cost = 1'000;
+    // Tasks visited at most when a new task extends the critical paths of the ones it waits for,
+    //  so that a long chain does not make every enqueue() walk all of it.
+    static constexpr std::size_t critical_path_walk = 64;
+    // Table slots checked for finished entries per newly tracked resource.
+    static constexpr std::size_t sweep_steps = 4;
+    // Parked workers taken off the list per acquisition of parking_mtx when waking many of them.
+    static constexpr std::size_t wake_batch = 16;
+    // Ids below this bound index the flat array of resource states, see QueueTraits.
+    static constexpr std::size_t dense_resources = Traits::dense_resources;
+    static constexpr bool dense = dense_resources > 0;
+    static constexpr bool statistics = Traits::statistics;
+    // Threads share the counters of a shard only when there are more of them.
+    static constexpr std::size_t stats_shard_count = 16;
+    // Neighbouring dense ids share a shard in blocks of this size, so a run of them locks few shards.
+    static constexpr std::size_t dense_shard_block = 64;
+    using shard_mask = std::uint64_t;
+
+    // Locks mtx, with statistics also measuring how long it took when it was held by another thread.
+    std::unique_lock<std::mutex> lock_shared();
+    // The counters of the current thread, only with statistics.
+    StatsShard& stats_shard() const;
+    // Counts the edges added on this thread since the last call, only with statistics.
+    void count_edges() const;
+    // Counts a dispatched task and the time it has been ready for.
+    void count_start(const TaskControl* tc) const;
+    // Waits for the slot to be signalled, counting the time parked.
+    void wait_parked(ParkingSlot* slot) const;
+
+    static constexpr bool tracing = Traits::tracing;
+    enum class TraceKind : std::uint8_t { enqueued, ready, started, finished, edge };
+
+    // The log of the current thread, only with tracing.
+    TraceBuffer& trace_buffer();
+    // Logs an event of the task on the current thread, the dependent is only set for edges.
+    void record_trace(TraceKind kind, std::uint64_t task, std::uint64_t dependent = 0);
+
+    std::size_t shard_of(resource_id r) const;
+    shard_mask shards_of(std::span<const resource_id> ids) const;
+    void lock_shards(shard_mask shards);
+    void unlock_shards(shard_mask shards);
+    // Holds the locks of the shards for its lifetime, so that a throwing enqueue does not leave them locked.
+    class ShardLock;
+
+    void push_ready(TaskRef tc);
+    // Pushes all the tasks with at most one acquisition of every lock involved, leaves them empty.
+    void push_ready(std::span<TaskRef> tasks);
+    // Pushes a task to the band of its priority, or to the heap ordered by critical paths
+    //  in its place, mtx has to be held.
+    void push_ready_locked(TaskRef tc);
+    // Dispatch order of the workers: the bands above normal priority, then the lock-free fast path,
+    //  then the rest of the bands.
+    bool try_pop_task(TaskRef& tc, WorkerDeque* local);
+    // Lock-free fast path of the dispatch, does not look into the mutex-protected bands.
+    bool try_pop_ready(TaskRef& tc, WorkerDeque* local);
+    // Takes mtx only if the bands from the given priority up do not look empty.
+    bool try_pop_fifo(TaskRef& tc, Priority min_priority);
+    // Same with mtx held.
+    bool pop_fifo_locked(TaskRef& tc, Priority min_priority);
+    // Whether any ready task seems to be waiting for a worker, only a hint.
+    bool has_ready_tasks() const;
+    bool try_steal(TaskRef& tc, WorkerDeque* thief);
+    // Wakes up to the given number of workers parked in serve(), has to be called
+    //  after the tasks were pushed. The workers are picked under parking_mtx, but signalled
+    //  after it is released. Each spinning worker is counted as already awake.
+    void wake_workers(std::size_t count);
+    // Wakes all the parked workers, so that they check why they parked again.
+    void wake_all_workers();
+    // Wakes the worker of the slot, but only if it is parked.
+    void wake_worker(ParkingSlot* slot);
+    // Signals the slots taken off the parked list, without holding parking_mtx.
+    static void signal_slots(std::span<ParkingSlot* const> slots);
 
+    // Puts the worker on the parked list and blocks until it is woken up, unless the condition
+    //  holds once it is listed. Returns the result of the condition, false after a wakeup.
+    template<class Condition>
+    bool park(ParkingSlot* slot, Condition&& condition);
+
+    // Polls for a task for up to the given number of rounds, with a growing pause between them.
+    // Gives up early when there is no unfinished task left, unless the worker stays anyway.
+    bool spin_for_task(TaskRef& tc, WorkerDeque* local, std::size_t rounds, bool stays_idle);
+    // Hint to the core that the thread is busy waiting.
+    static void cpu_relax() noexcept;
+    // Drops the last reference to an unfinished task, appends it to the ready ones if it was the last one.
+    // A read group has nothing to run, it finishes instead.
+    // Given an empty continuation, the first ready task of normal priority is left there instead.
+    void release_dependency(TaskRef tc, std::vector<TaskRef>& new_ready, TaskRef* continuation = nullptr);
+    // Stamps a task whose last dependency was released, for the statistics and the trace.
+    void mark_ready(TaskControl* tc);
+    // Marks the task finished and releases its dependents.
+    void finish_task(TaskControl* tc, std::vector<TaskRef>& new_ready, TaskRef* continuation = nullptr);
+
+    // Pushes the newly enqueued ready tasks and wakes the workers, or leaves them to the end
+    //  of the current task when it defers its enqueues. Leaves the span empty.
+    void publish_ready(std::span<TaskRef> tasks);
+    // Pushes the tasks deferred by the current task of the thread.
+    void publish_deferred();
+
+    // Unique for every enqueue() call on any queue, never zero.
+    static std::uint64_t next_enqueue_epoch();
+
+    // The state of the resource, its shard has to be locked.
+    ResourceState& state_of(resource_id r);
+
+    // Makes the task depend on the given one, once per epoch of the enqueue() that records it.
+    static void depend_on(const TaskRef& tc, const TaskRef& dep, std::uint64_t epoch);
+    // Drops the hold of the table on the readers once a writer depends on them, if they are a group
+    //  that is still open.
+    void close_read_group(const TaskRef& readers);
+
+    // Makes the task depend on the previous users of its resources and records it as their last user,
+    //  the shards of all the resources have to be locked. The resources have to be unique.
+    void record_task(const TaskRef& tc, std::span<const resource_id> write_ids, std::span<const resource_id> read_ids);
+    // Same for resource ranges, the lock of the range table has to be held instead.
+    // The ranges have to be sorted and disjoint.
+    void record_ranges(const TaskRef& tc, std::span<const resource_range> write_ranges, std::span<const resource_range> read_ranges);
+    // Same for resource nodes and all the nodes above them, the lock of the node table has to be held.
+    void record_nodes(const TaskRef& tc, std::span<const resource_node> write_nodes, std::span<const resource_node> read_nodes);
+
+    // The ids of a list without duplicates, sorted unless they are dense, see SortedIds.
+    template<std::size_t Slot, class Range>
+    using UniqueIds = std::conditional_t<dense, DenseIds<resource_id, Slot, dense_resources>, SortedIds<resource_id, Slot, Range>>;
+    template<class Range>
+    static void append_unique_ids(std::vector<resource_id>& buffer, Range&& list);
+
+    // Whether the resources of the list are ranges or nodes rather than ids.
+    template<class Range>
+    static constexpr bool lists_ranges = std::same_as<std::ranges::range_value_t<Range>, resource_range>;
+    template<class Range>
+    static constexpr bool lists_nodes = std::same_as<std::ranges::range_value_t<Range>, resource_node>;
+    // The list itself if it holds ids, an empty one otherwise.
+    template<class Range>
+    static decltype(auto) listed_ids(Range&& list);
+    // The non-empty ranges of the list sorted and merged where they overlap or touch, in a thread-local
+    //  buffer of the slot, empty if the list does not hold ranges.
+    template<std::size_t Slot, class Range>
+    static std::span<const resource_range> listed_ranges(Range&& list);
+    // The nodes of the list in a thread-local buffer of the slot, empty if the list does not hold nodes.
+    template<std::size_t Slot, class Range>
+    static std::span<const resource_node> listed_nodes(Range&& list);
+
+    // Visits the unfinished tasks that the task waits for, directly or not, at most the given number,
+    //  every one with its lock held. Each link carries a value, skip(node, value) is checked before
+    //  taking the lock and visit(node, value) may update the value passed on to the predecessors
+    //  of the node, or return false to stop there.
+    template<class Value, class Skip, class Visit>
+    void walk_predecessors(TaskControl* tc, Value value, std::size_t budget, Skip&& skip, Visit&& visit);
+
+    // Raises the unfinished tasks that the task waits for, directly or not, to its priority.
+    // Ready tasks that are still queued at a lower priority are pushed once more to the higher band,
+    //  whichever copy is popped first runs the task and the other one is dropped.
+    void inherit_priority(TaskControl* tc);
+
+    // Sets the critical path of a new task to its own cost and makes it the tail of the paths
+    //  of the tasks it waits for. Queued tasks whose path grew enough are pushed to the heap once more.
+    void extend_critical_paths(TaskControl* tc);
+    // Learned execution time of the tasks of the class in nanoseconds.
+    std::uint64_t cost_of(cost_class_id cost_class) const;
+    void learn_cost(cost_class_id cost_class, std::chrono::nanoseconds elapsed);
+
+    // Reused by the enqueue_batch() and submit() calls of the thread, so that they only allocate while the batches grow.
+    static BatchBuffers& batch_buffers();
+    // Collects the tasks released by one enqueue() or one finished task of the thread, empty in between.
+    static std::vector<TaskRef>& released_buffer();
+
+    // Whether the elements of the range can be moved from: it is an rvalue container or yields rvalues.
+    template<class Range>
+    static constexpr bool moves_elements = !std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>
+        || (!std::is_lvalue_reference_v<Range> && !std::ranges::view<std::remove_cvref_t<Range>>);
+
+    // Makes the tasks ready whose only remaining dependency was the hold of the enqueuing thread,
+    //  drops the references to the others and wakes the workers, leaves the span empty.
+    void release_holds(std::span<TaskRef> tasks);
+
+    WorkerDeque* acquire_worker_deque();
+    // Slots are reused by the next worker, they are only freed with the queue, so that a waker
+    //  may still touch a slot whose worker has already left.
+    ParkingSlot* acquire_parking_slot();
+    void release_parking_slot(ParkingSlot* slot);
+
+    // The part of enqueue() after the task was created.
+    template<class WRange, class RRange>
+    void enqueue_task(TaskRef tc, WRange&& writes, RRange&& reads);
+
+    // Enqueues the rest of the coroutine up to its next suspension as a task.
+    template<class WRange, class RRange>
+    void enqueue_step(std::coroutine_handle<> handle, WRange&& writes, RRange&& reads, Priority priority, cost_class_id cost_class);
+
+    // Runs a ready task on a worker thread and releases its dependents, then the continuations.
+    // Does nothing if the task was already dispatched through another copy.
+    void run_task(TaskRef tc, WorkerDeque* local);
+
+    // Returns once the task has finished. A worker of this queue runs the other ready tasks
+    //  in the meantime and only parks when there are none, other threads just block.
+    void wait_for(TaskControl* tc);
+
+    // Body of serve() and of the worker threads. Threads calling serve() return once the queue is
+    //  empty, the worker threads of the queue only once it is empty and being shut down.
+    void run_worker(bool owned_thread);
+
+    // The worker deque of the thread if it is currently serving this queue.
+    WorkerDeque* local_deque() const;
+
+    // Set for the duration of serve(), so that enqueue() from inside a task can push locally.
+    struct WorkerContext {
+        const BasicQueue* queue = nullptr;
+        WorkerDeque* deque = nullptr;
+        // Ready tasks enqueued by the running task, only with defer_nested_enqueues.
+        std::vector<TaskRef>* deferred = nullptr;
+        ParkingSlot* parking = nullptr;
+        // Set on the worker threads of the queue, which keep the exceptions of the tasks instead of leaving.
+        bool owned_thread = false;
+    };
+    static thread_local WorkerContext current_worker;
+
+    Scheduling scheduling = Scheduling::fifo;
+
+    // Only guards the bands of ready tasks and wait_idle(), the dependency tracking
+    //  is synchronized by the shard and task locks and the workers park on their own slots.
     mutable std::mutex mtx;
-    std::condition_variable ready;
-    std::queue<std::shared_ptr<TaskControl>> ready_tasks;
-    size_t unfinished_tasks = 0;
-    size_t waiting_workers = 0;
+    // Only allocated with statistics.
+    std::unique_ptr<StatsShard[]> stats_shards;
+    // Only used with tracing. The logs are only ever prepended, every thread finds its own by walking them.
+    std::atomic<TraceBuffer*> trace_buffers{ nullptr };
+    std::atomic<std::size_t> traced_threads{ 0 };
+    std::size_t trace_buffer_capacity = 0;
+    // Tells the logs of this queue apart from those of the queues the thread used before.
+    std::uint64_t trace_queue = 0;
+    std::chrono::steady_clock::time_point trace_start;
+    // Notified when the last unfinished task finishes.
+    std::condition_variable idle;
+    PriorityBands<TaskRef, priority_levels> ready_tasks;
+    // Size of ready_tasks, lets spinning workers skip the lock while the bands are empty.
+    std::atomic<size_t> ready_size{ 0 };
+    // Tasks in the bands above normal priority, checked before every dispatch.
+    std::atomic<size_t> urgent_size{ 0 };
+    // Takes the place of the normal band with critical path scheduling, ready_size counts it too.
+    std::vector<RankedTask> ranked_tasks;
+    // Keeps the tasks with equal critical paths in the order they became ready.
+    std::uint64_t ranked_sequence = 0;
+    // Moving averages of the execution times in nanoseconds, zero until the class has run.
+    std::atomic<std::uint64_t> cost_estimates[cost_classes]{};
+    std::unique_ptr<BoundedMpmcQueue<TaskRef>> lock_free_ready;
+    // Deques are only ever prepended and live until the queue is destroyed, so thieves
+    //  can walk the list without locking. A deque is reused by the next serve() call.
+    std::atomic<WorkerDeque*> worker_deques{ nullptr };
+    std::atomic<size_t> unfinished_tasks{ 0 };
+    // Size of parked, lets producers skip parking_mtx while no worker is parked.
+    std::atomic<size_t> waiting_workers{ 0 };
+    std::atomic<size_t> spinning_workers{ 0 };
+    std::size_t max_spin_rounds = 0;
+    std::size_t max_continuations = 0;
+    bool defer_nested_enqueues = false;
+
+    // Guards the parked list and the slots, only held to pick the workers to wake, never while waking them.
+    std::mutex parking_mtx;
+    // The most recently parked worker is the last one and the first one to be woken up, its cache is the warmest.
+    std::vector<ParkingSlot*> parked;
+    std::vector<std::unique_ptr<ParkingSlot>> parking_slots;
+
+    std::vector<std::thread> worker_pool;
+    std::atomic<bool> shutting_down{ false };
+    // The first exception of a task on the worker threads not yet rethrown, guarded by mtx.
+    std::exception_ptr worker_error;
+
+    std::unique_ptr<ResourceShard[]> shards;
+    std::size_t shard_count = 0;
+    // The states of the dense resource ids, each guarded by the lock of its shard. Only allocated
+    //  for dense ids, the hash tables of the shards stay empty then.
+    std::unique_ptr<ResourceState[]> dense_states;
+    // Only locked by the tasks with resource ranges, after the shards.
+    std::unique_ptr<RangeTable> range_table;
+    // Only locked by the tasks with resource nodes, after the range table.
+    std::unique_ptr<NodeTable> node_table;
+
+    // The tasks of the last submission of every graph that the next submission has to wait for.
+    // Entries whose tasks have all finished are swept as new graphs are submitted.
+    std::mutex graphs_mtx;
+    FlatHashMap<std::uint64_t, std::vector<TaskRef>, ResourceHash> graph_exits;
+};
+
+
+// Intrusively reference counted, the nodes come from ObjectPool and go back to it
+//  when the last reference is dropped, with the containers keeping their capacity.
+template<class Traits>
+struct BasicQueue<Traits>::TaskControl {
+    UniqueTask<task_inline_size> task;
+    // Starts at one, the extra reference is held by enqueue() until all the edges are in place.
+    std::atomic<size_t> dependency_count{ 1 };
+    std::atomic<std::uint32_t> references{ 0 };
+    // Epoch of the last enqueue() that made another task depend on this one, so that
+    //  a task listed under many resources of the new one gets a single edge.
+    std::atomic<std::uint64_t> dependency_epoch{ 0 };
+
+    // Guards the dependents and setting the finished flag, so that an edge is either added
+    //  before the task finishes or not at all. The flag may be read without it.
+    std::mutex mtx;
+    std::vector<TaskRef> dependents;
+    std::atomic<bool> finished{ false };
+    // Set by a thread waiting for the task through a handle, so that finishing it has to wake it up.
+    std::atomic<bool> waited{ false };
+    // Slots of the workers helping while they wait, added under mtx before the task finishes.
+    std::vector<ParkingSlot*> waiters;
 
-    std::unordered_map<resource_id, std::weak_ptr<TaskControl>> last_writer;
-    std::unordered_map<resource_id, std::weak_ptr<TaskControl>> last_task;
+    // Read groups have no callable, they stand for the readers of a resource between two writes
+    //  once there is more than one, so that the next writer needs a single edge to wait for all of them.
+    // Every unfinished reader holds one dependency of the group and the table holds one more while
+    //  it is open, so the group finishes once the next writer closed it and all the readers finished.
+    bool read_group = false;
+    // Whether the table still holds the group. A group of the range table may be listed by many
+    //  intervals and stays open until the first writer of any of them closes it, the others treat it
+    //  as a single reader from then on. Guarded by the lock of the table that lists the group.
+    bool open_group = false;
+
+    // Only ever raised while the task is alive, under mtx.
+    std::atomic<Priority> priority{ Priority::normal };
+    // Claimed by the worker that runs the task, a boosted task may sit in the ready queue twice.
+    std::atomic<bool> dispatched{ false };
+
+    // Tasks this one waits for, so that it can pass its priority on. They are not kept alive
+    //  by the link, the generation tells whether the node still holds the same task,
+    //  pooled nodes are never freed. Cleared once the task finishes.
+    struct Predecessor {
+        TaskControl* tc;
+        std::uint32_t generation;
+    };
+    std::vector<Predecessor> predecessors;
+    // Incremented every time the node is recycled.
+    std::atomic<std::uint32_t> generation{ 0 };
+
+    cost_class_id cost_class = 0;
+    // Only kept with critical path scheduling, in nanoseconds. The cost is the learned execution time
+    //  of the class when the task was enqueued, zero for read groups. The path length adds the longest
+    //  chain of tasks waiting for it and is never lowered while the task is alive.
+    std::atomic<std::uint64_t> cost{ 0 };
+    std::atomic<std::uint64_t> path_length{ 0 };
+    // Path length the task was last pushed to the ready heap with.
+    std::atomic<std::uint64_t> ranked_path_length{ 0 };
+
+    // Only kept with statistics, when the last dependency was released.
+    struct Unused {};
+    [[no_unique_address]] std::conditional_t<statistics, std::chrono::steady_clock::time_point, Unused> ready_time;
+    // Edges added on the current thread and not counted yet, only with statistics.
+    static thread_local std::uint64_t added_edges;
+    // Only kept with tracing, names the task in the logs.
+    [[no_unique_address]] std::conditional_t<tracing, std::uint64_t, Unused> trace_id;
+    // The log of the queue enqueuing on the current thread, the edges are logged into it.
+    static thread_local TraceBuffer* edge_trace;
+
+    TaskControl* pool_next = nullptr;
+
+    template<class Func>
+    static TaskRef create(Func&& func);
+    static TaskRef create_read_group();
+
+    // Returns false if the task has already finished and there is nothing to wait for.
+    bool add_dependent(const TaskRef& dependent);
+
+    // Whether the task is ready and waits for a worker, the lock has to be held.
+    bool queued() const;
+
+    // Adds the edge and records this task as a predecessor of the dependent, which nobody
+    //  may be walking yet: it is still held by the enqueue() or an open read group.
+    bool add_dependent_linked(const TaskRef& dependent);
+
+    // Drops one reference, recycles the task (and the dependents it kept alive) if it was the last one.
+    static void release(TaskControl* tc);
 };
 
 
-struct Queue::TaskControl {
-    std::function<void()> task;
-    std::atomic<size_t> dependency_count{ 0 };
-    std::vector<std::shared_ptr<TaskControl>> dependents;
-    bool finished = false;
+template<class Traits>
+class BasicQueue<Traits>::TaskRef {
+public:
+    TaskRef() = default;
+
+    // Adopts a reference that was already counted.
+    explicit TaskRef(TaskControl* tc) noexcept : tc(tc) {}
+
+    TaskRef(const TaskRef& other) noexcept : tc(other.tc) {
+        if (tc) tc->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TaskRef(TaskRef&& other) noexcept : tc(std::exchange(other.tc, nullptr)) {}
+
+    TaskRef& operator=(TaskRef other) noexcept {
+        std::swap(tc, other.tc);
+        return *this;
+    }
+
+    ~TaskRef() {
+        if (tc) TaskControl::release(tc);
+    }
+
+    TaskControl* get() const noexcept { return tc; }
+    TaskControl* operator->() const noexcept { return tc; }
+    explicit operator bool() const noexcept { return tc != nullptr; }
 
-    TaskControl(std::function<void()>);
+    // Gives up the reference without dropping it.
+    TaskControl* detach() noexcept { return std::exchange(tc, nullptr); }
+
+private:
+    TaskControl* tc = nullptr;
 };
 
-Queue::TaskControl::TaskControl(std::function<void()> t)
-    : task(std::move(t)) {
-}
 
+// Keeps the task alive, not the queue, which has to outlive the waiting.
+template<class Traits>
+template<class T>
+class BasicQueue<Traits>::TaskHandle {
+public:
+    TaskHandle() = default;
 
-template<std::invocable Func, std::ranges::input_range WRange, std::ranges::input_range RRange>
-    requires std::convertible_to<std::ranges::range_value_t<WRange>, resource_id>
-&& std::convertible_to<std::ranges::range_value_t<RRange>, resource_id>
-void Queue::enqueue(Func&& task, WRange&& writes, RRange&& reads) {
-    std::set<resource_id> write_set;
-    std::set<resource_id> read_set;
+    TaskHandle(TaskHandle&&) noexcept = default;
+    TaskHandle& operator=(TaskHandle&&) noexcept = default;
 
-    for (auto&& w : writes) write_set.insert(static_cast<resource_id>(w));
-    for (auto&& r : reads) read_set.insert(static_cast<resource_id>(r));
+    TaskHandle(const TaskHandle&) = delete;
+    TaskHandle& operator=(const TaskHandle&) = delete;
 
-    std::shared_ptr<TaskControl> tc;
-    {
-        std::lock_guard<std::mutex> guard(mtx);
-        tc = std::make_shared<TaskControl>(std::forward<Func>(task));
-        unfinished_tasks++;
+    // False for default-constructed and moved-from handles.
+    bool valid() const noexcept { return static_cast<bool>(tc); }
 
-        std::set<std::shared_ptr<TaskControl>> dependencies;
+    // Whether the task has finished, does not block.
+    bool ready() const noexcept { return tc->finished.load(std::memory_order_acquire); }
 
-        for (resource_id r : write_set) {
-            if (auto it = last_task.find(r); it != last_task.end()) {
-                if (auto last_task = it->second.lock()) {
-                    if (!last_task->finished) {
-                        dependencies.insert(last_task);
-                    }
-                }
-            }
+    // Blocks until the task has finished. Called from a task of the same queue, the thread runs
+    //  other ready tasks instead of blocking, so the waited task must not depend on the waiting one.
+    void wait() const { queue->wait_for(tc.get()); }
 
-            last_writer[r] = tc;
-            last_task[r] = tc;
-        }
+    // Waits for the task and moves its result out, or rethrows its exception. May be called once.
+    T get();
 
-        for (resource_id r : read_set) {
-            if (auto it = last_writer.find(r); it != last_writer.end()) {
-                if (auto last_writer = it->second.lock()) {
-                    if (!last_writer->finished) {
-                        dependencies.insert(last_writer);
-                    }
-                }
-            }
+private:
+    friend BasicQueue;
+
+    struct NoValue {};
+
+    struct Result {
+        std::optional<std::conditional_t<std::is_void_v<T>, NoValue, T>> value;
+        std::exception_ptr error;
+    };
+
+    TaskHandle(BasicQueue* queue, TaskRef tc, std::shared_ptr<Result> result)
+        : queue(queue), tc(std::move(tc)), result(std::move(result)) {
+    }
+
+    BasicQueue* queue = nullptr;
+    TaskRef tc;
+    std::shared_ptr<Result> result;
+};
+
+template<class Traits>
+template<class T>
+T BasicQueue<Traits>::TaskHandle<T>::get() {
+    wait();
+
+    const std::shared_ptr<Result> taken = std::move(result);
+    tc = TaskRef();
+
+    if (taken->error) std::rethrow_exception(taken->error);
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*taken->value);
+    }
+}
+
+
+// Owns the frame of a coroutine until it is enqueued. The frame is freed as soon as the body returns,
+//  so a lambda coroutine must not refer to its captures, which die with the enqueued lambda object.
+// An exception leaving the body leaves serve() like one thrown by a plain task.
+template<class Traits>
+class BasicQueue<Traits>::Coroutine {
+public:
+    struct promise_type {
+        Priority priority = Priority::normal;
+        cost_class_id cost_class = 0;
+
+        Coroutine get_return_object() { return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const { throw; }
+    };
 
-            last_task[r] = tc;
+    Coroutine(Coroutine&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Coroutine& operator=(Coroutine&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
         }
+        return *this;
+    }
+
+    Coroutine(const Coroutine&) = delete;
+    Coroutine& operator=(const Coroutine&) = delete;
+
+    ~Coroutine() {
+        if (handle) handle.destroy();
+    }
+
+private:
+    friend BasicQueue;
+
+    explicit Coroutine(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<class Traits>
+template<class WRange, class RRange>
+class BasicQueue<Traits>::Acquire {
+public:
+    bool await_ready() const noexcept { return false; }
+
+    // Another worker may resume the coroutine, and free the frame holding this awaiter, as soon
+    //  as the step is enqueued, so nothing is touched afterwards.
+    void await_suspend(std::coroutine_handle<typename Coroutine::promise_type> handle) {
+        const typename Coroutine::promise_type& promise = handle.promise();
+        queue->enqueue_step(handle, std::move(writes), std::move(reads), promise.priority, promise.cost_class);
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    friend BasicQueue;
 
-        tc->dependency_count = dependencies.size();
-        for (auto&& dep : dependencies) dep->dependents.push_back(tc);
+    Acquire(BasicQueue* queue, WRange writes, RRange reads)
+        : queue(queue), writes(std::move(writes)), reads(std::move(reads)) {
+    }
+
+    BasicQueue* queue;
+    WRange writes;
+    RRange reads;
+};
+
+// The task resuming a coroutine, it gives up the frame when it resumes it: by the time resume()
+//  returns the frame belongs to the next step or is gone.
+template<class Traits>
+struct BasicQueue<Traits>::CoroutineStep {
+    std::coroutine_handle<> handle;
 
-        if (tc->dependency_count == 0) {
-            ready_tasks.push(tc);
-            if (waiting_workers > 0) ready.notify_one();
+    explicit CoroutineStep(std::coroutine_handle<> handle) : handle(handle) {}
+    CoroutineStep(CoroutineStep&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    CoroutineStep& operator=(CoroutineStep&&) = delete;
+
+    ~CoroutineStep() {
+        if (handle) handle.destroy();
+    }
+
+    void operator()() {
+        const auto resumed = std::exchange(handle, nullptr);
+        try {
+            resumed.resume();
+        }
+        catch (...) {
+            // The coroutine stopped at its final suspension point without freeing the frame.
+            resumed.destroy();
+            throw;
         }
     }
+};
+
+
+template<class Traits>
+template<class Func>
+typename BasicQueue<Traits>::TaskRef BasicQueue<Traits>::TaskControl::create(Func&& func) {
+    TaskControl* tc = ObjectPool<TaskControl>::acquire();
+    tc->task.emplace(std::forward<Func>(func));
+    tc->references.store(1, std::memory_order_relaxed);
+    if constexpr (tracing) tc->trace_id = next_enqueue_epoch();
+    return TaskRef(tc);
+}
+
+template<class Traits>
+typename BasicQueue<Traits>::TaskRef BasicQueue<Traits>::TaskControl::create_read_group() {
+    TaskControl* tc = ObjectPool<TaskControl>::acquire();
+    tc->read_group = true;
+    tc->open_group = true;
+    tc->references.store(1, std::memory_order_relaxed);
+    if constexpr (tracing) tc->trace_id = next_enqueue_epoch();
+    return TaskRef(tc);
 }
 
+template<class Traits>
+bool BasicQueue<Traits>::TaskControl::add_dependent(const TaskRef& dependent) {
+    std::lock_guard<std::mutex> guard(mtx);
+    if (finished.load(std::memory_order_relaxed)) return false;
 
-void Queue::serve() {
-    while (true) {
-        std::shared_ptr<TaskControl> tc;
-        {
-            std::unique_lock<std::mutex> serve_lock(mtx);
-            ++waiting_workers;
-            ready.wait(serve_lock, [this] { return !ready_tasks.empty() || unfinished_tasks == 0; });
-            --waiting_workers;
+    dependent->dependency_count.fetch_add(1, std::memory_order_relaxed);
+    dependents.push_back(dependent);
+    if constexpr (statistics) added_edges++;
+    if constexpr (tracing) edge_trace->events.push({ TraceKind::edge, trace_id, dependent->trace_id, 0 });
+    return true;
+}
 
-            if (unfinished_tasks == 0 && ready_tasks.empty()) return;
+template<class Traits>
+bool BasicQueue<Traits>::TaskControl::queued() const {
+    return !read_group && dependency_count.load(std::memory_order_acquire) == 0 && !dispatched.load(std::memory_order_acquire);
+}
+
+template<class Traits>
+bool BasicQueue<Traits>::TaskControl::add_dependent_linked(const TaskRef& dependent) {
+    if (!add_dependent(dependent)) return false;
+
+    // A resource that is only ever read keeps its group open, so the links to the readers which
+    //  have finished are dropped before the vector grows, and it only grows while mostly full.
+    std::vector<Predecessor>& links = dependent->predecessors;
+    if (links.size() == links.capacity() && !links.empty()) {
+        std::erase_if(links, [](const Predecessor& link) {
+            return link.tc->finished.load(std::memory_order_acquire) || link.tc->generation.load(std::memory_order_relaxed) != link.generation;
+            });
+        if (2 * links.size() > links.capacity()) links.reserve(2 * links.capacity());
+    }
+
+    links.push_back({ this, generation.load(std::memory_order_relaxed) });
+    return true;
+}
+
+template<class Traits>
+void BasicQueue<Traits>::TaskControl::release(TaskControl* tc) {
+    if (tc->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    // Unfinished tasks keep their dependents alive, which may be long chains when
+    //  a queue is destroyed before it was served, so they are recycled iteratively.
+    tc->pool_next = nullptr;
+    while (tc) {
+        TaskControl* dead = std::exchange(tc, tc->pool_next);
+        // Before anything is reset, so that a stale link which still sees the task unfinished
+        //  also sees the new generation.
+        dead->generation.fetch_add(1, std::memory_order_relaxed);
 
-            if (!ready_tasks.empty()) {
-                tc = ready_tasks.front();
-                ready_tasks.pop();
+        for (TaskRef& dependent : dead->dependents) {
+            TaskControl* next = dependent.detach();
+            if (next->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                next->pool_next = tc;
+                tc = next;
             }
-            else continue;
         }
 
-        tc->task();
+        dead->dependents.clear();
+        dead->predecessors.clear();
+        dead->task.reset();
+        dead->dependency_count.store(1, std::memory_order_relaxed);
+        dead->priority.store(Priority::normal, std::memory_order_relaxed);
+        dead->cost_class = 0;
+        dead->cost.store(0, std::memory_order_relaxed);
+        dead->path_length.store(0, std::memory_order_relaxed);
+        dead->ranked_path_length.store(0, std::memory_order_relaxed);
+        dead->dispatched.store(false, std::memory_order_relaxed);
+        dead->finished.store(false, std::memory_order_release);
+        dead->read_group = false;
+        dead->open_group = false;
+        dead->waited.store(false, std::memory_order_relaxed);
+        dead->waiters.clear();
+        ObjectPool<TaskControl>::release(dead);
+    }
+}
 
-        {
-            std::lock_guard<std::mutex> guard(mtx);
-            tc->finished = true;
-
-            size_t new_ready = 0;
-            for (auto&& dep : tc->dependents) {
-                dep->dependency_count--;
-                if (dep->dependency_count == 0) {
-                    ready_tasks.push(dep);
-                    new_ready++;
-                }
-            }
-            tc->dependents.clear();
-            unfinished_tasks--;
 
-            if (new_ready > 0) 
-                for (size_t i = 0; i < std::min(new_ready, waiting_workers); i++) 
-                    ready.notify_one();
-            else if (unfinished_tasks == 0) 
-                ready.notify_all();
+template<class Traits>
+struct BasicQueue<Traits>::ResourceHash {
+    // Resource ids are often addresses with the low bits all zero, so the bits have to be mixed
+    //  before the table takes the low 7 as the control byte and the shard takes the top ones.
+    std::size_t operator()(resource_id r) const noexcept {
+        std::uint64_t x = static_cast<std::uint64_t>(r);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return static_cast<std::size_t>(x ^ (x >> 31));
+    }
+};
+
+// Both the writer and the readers of a resource share one slot, so the enqueue() does a single probe per resource.
+template<class Traits>
+struct BasicQueue<Traits>::ResourceState {
+    TaskRef last_writer;
+    // The readers since the last write: nothing, a single reader, or the read group of several.
+    TaskRef readers;
+
+    // Nothing is waiting on the resource any more, a new task would not depend on anything.
+    bool idle() const;
+};
+
+template<class Traits>
+bool BasicQueue<Traits>::ResourceState::idle() const {
+    // An open group whose readers all finished only holds the reference of the table.
+    if (readers && readers->read_group) return readers->dependency_count.load(std::memory_order_acquire) == 1;
+    if (readers) return readers->finished.load(std::memory_order_acquire);
+    return !last_writer || last_writer->finished.load(std::memory_order_acquire);
+}
+
+template<class Traits>
+struct BasicQueue<Traits>::ResourceShard {
+    std::mutex mtx;
+    FlatHashMap<resource_id, ResourceState, ResourceHash> resources;
+
+    // Returns the state of the resource. Starting to track a new one first sweeps a few idle entries,
+    //  such an entry imposes no dependency and can be dropped.
+    ResourceState& track(resource_id r);
+};
+
+template<class Traits>
+struct BasicQueue<Traits>::RangeTable {
+    std::mutex mtx;
+    IntervalMap<resource_id, ResourceState> intervals;
+};
+
+// Every task accessing a node reaches the nodes above it as well, with an access of the part below.
+// The readers of a node are the tasks of the last run of compatible accesses, the modes of all of them
+//  or-ed together, two accesses conflict when they make up write_all together. So reading below a node
+//  only conflicts with writing all of it, and writing below it with reading or writing all of it.
+template<class Traits>
+struct BasicQueue<Traits>::NodeTable {
+    enum Access : std::uint8_t {
+        read_below = 1,
+        write_below = 3,
+        read_all = 5,
+        write_all = 7,
+    };
+
+    struct Node {
+        // The node itself for a root.
+        std::uint32_t parent;
+        std::uint8_t shared = 0;
+        ResourceState state;
+    };
+
+    std::mutex mtx;
+    std::vector<Node> nodes;
+};
+
+template<class Traits>
+typename BasicQueue<Traits>::ResourceState& BasicQueue<Traits>::ResourceShard::track(resource_id r) {
+    if (ResourceState* state = resources.find(r)) return *state;
+
+    resources.sweep(sweep_steps, [](const ResourceState& state) {
+        return state.idle();
+        });
+    return resources[r];
+}
+
+
+// The normalized resources of all the tasks of a batch follow each other in one buffer,
+//  every entry remembers where its writes and reads end.
+template<class Traits>
+struct BasicQueue<Traits>::BatchBuffers {
+    struct Bounds {
+        std::size_t writes_end;
+        std::size_t reads_end;
+    };
+
+    std::vector<resource_id> ids;
+    std::vector<Bounds> bounds;
+    std::vector<TaskRef> tasks;
+
+    // Empties the buffers at the end of the scope, also when a callable throws while being copied,
+    //  so that the tasks created until then are dropped and not run by the next batch.
+    struct Reset {
+        BatchBuffers& buffers;
+
+        ~Reset() {
+            buffers.tasks.clear();
+            buffers.bounds.clear();
+            buffers.ids.clear();
         }
+    };
+};
+
+template<class Traits>
+struct BasicQueue<Traits>::RankedTask {
+    std::uint64_t path_length;
+    std::uint64_t sequence;
+    TaskRef tc;
+
+    // Heap order, the task that comes later is the lesser one.
+    friend bool operator<(const RankedTask& a, const RankedTask& b) {
+        if (a.path_length != b.path_length) return a.path_length < b.path_length;
+        return a.sequence > b.sequence;
+    }
+};
+
+
+template<class Traits>
+typename BasicQueue<Traits>::BatchBuffers& BasicQueue<Traits>::batch_buffers() {
+    static thread_local BatchBuffers buffers;
+    return buffers;
+}
+
+template<class Traits>
+std::vector<typename BasicQueue<Traits>::TaskRef>& BasicQueue<Traits>::released_buffer() {
+    static thread_local std::vector<TaskRef> released;
+    return released;
+}
+
+
+template<class Traits>
+thread_local typename BasicQueue<Traits>::WorkerContext BasicQueue<Traits>::current_worker;
+
+template<class Traits>
+thread_local std::uint64_t BasicQueue<Traits>::TaskControl::added_edges = 0;
+
+template<class Traits>
+thread_local typename BasicQueue<Traits>::TraceBuffer* BasicQueue<Traits>::TaskControl::edge_trace = nullptr;
+
+// Written by the threads of the shard with relaxed increments and read by stats() at any time.
+template<class Traits>
+struct alignas(cache_line_size) BasicQueue<Traits>::StatsShard {
+    std::atomic<std::uint64_t> tasks_enqueued{ 0 };
+    std::atomic<std::uint64_t> tasks_started{ 0 };
+    std::atomic<std::uint64_t> tasks_completed{ 0 };
+    std::atomic<std::uint64_t> dependency_edges{ 0 };
+    std::atomic<std::uint64_t> lock_wait_ns{ 0 };
+    std::atomic<std::uint64_t> parked_ns{ 0 };
+    std::atomic<std::uint64_t> ready_latency[QueueStats::latency_buckets]{};
+
+    static void add(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+};
+
+template<class Traits>
+struct BasicQueue<Traits>::TraceEvent {
+    TraceKind kind;
+    std::uint64_t task;
+    std::uint64_t dependent;
+    // Nanoseconds since the queue was created, not kept for edges.
+    std::int64_t time;
+};
+
+// Only written by the thread that owns it, or by a later thread that got the same id.
+template<class Traits>
+struct BasicQueue<Traits>::TraceBuffer {
+    explicit TraceBuffer(std::size_t capacity) : events(capacity) {}
+
+    EventRing<TraceEvent> events;
+    std::thread::id owner = std::this_thread::get_id();
+    // The track of the thread in the trace.
+    std::size_t thread_index = 0;
+    TraceBuffer* next = nullptr;
+};
+
+
+template<class Traits>
+struct BasicQueue<Traits>::WorkerDeque {
+    std::mutex mtx;
+    RingDeque<TaskRef> tasks;
+    // Lets thieves skip empty deques without touching their lock.
+    std::atomic<size_t> size{ 0 };
+    std::atomic<bool> in_use{ false };
+    WorkerDeque* next = nullptr;
+
+    void push(std::span<TaskRef> tcs);
+    bool pop(TaskRef& tc);
+    bool steal(TaskRef& tc);
+};
+
+template<class Traits>
+void BasicQueue<Traits>::WorkerDeque::push(std::span<TaskRef> tcs) {
+    std::lock_guard<std::mutex> guard(mtx);
+    for (TaskRef& tc : tcs) tasks.push_back(std::move(tc));
+    size.store(tasks.size(), std::memory_order_relaxed);
+}
+
+template<class Traits>
+bool BasicQueue<Traits>::WorkerDeque::pop(TaskRef& tc) {
+    if (size.load(std::memory_order_relaxed) == 0) return false;
+
+    std::lock_guard<std::mutex> guard(mtx);
+    if (tasks.empty()) return false;
+
+    tc = tasks.pop_back();
+    size.store(tasks.size(), std::memory_order_relaxed);
+    return true;
+}
+
+// The futex word of a parked worker. Whoever takes the slot off the parked list signals it
+//  exactly once, and the worker consumes the signal before it parks again, so no signal
+//  can hit a later park of the slot.
+template<class Traits>
+struct BasicQueue<Traits>::ParkingSlot {
+    std::atomic<std::uint32_t> signal{ 0 };
+    // Guarded by parking_mtx.
+    bool in_use = false;
+
+    void wait_for_signal() {
+        while (signal.load(std::memory_order_acquire) == 0) signal.wait(0, std::memory_order_acquire);
+        signal.store(0, std::memory_order_relaxed);
+    }
+};
+
+template<class Traits>
+bool BasicQueue<Traits>::WorkerDeque::steal(TaskRef& tc) {
+    if (size.load(std::memory_order_relaxed) == 0) return false;
+
+    std::lock_guard<std::mutex> guard(mtx);
+    if (tasks.empty()) return false;
+
+    tc = tasks.pop_front();
+    size.store(tasks.size(), std::memory_order_relaxed);
+    return true;
+}
+
 
+template<class Traits>
+BasicQueue<Traits>::BasicQueue(QueueOptions options)
+    : scheduling(options.scheduling), max_spin_rounds(options.max_spin_rounds), max_continuations(options.max_continuations),
+    defer_nested_enqueues(options.defer_nested_enqueues) {
+    if (options.ready_queue_capacity > 0 && scheduling != Scheduling::critical_path) {
+        lock_free_ready = std::make_unique<BoundedMpmcQueue<TaskRef>>(options.ready_queue_capacity);
+    }
+
+    shard_count = std::bit_ceil(std::clamp<std::size_t>(options.resource_shards, 1, max_resource_shards));
+    shards = std::make_unique<ResourceShard[]>(shard_count);
+    if constexpr (dense) dense_states = std::make_unique<ResourceState[]>(dense_resources);
+    range_table = std::make_unique<RangeTable>();
+    node_table = std::make_unique<NodeTable>();
+    if constexpr (statistics) stats_shards = std::make_unique<StatsShard[]>(stats_shard_count);
+    if constexpr (tracing) {
+        trace_buffer_capacity = options.trace_buffer_capacity;
+        trace_queue = next_enqueue_epoch();
+        trace_start = std::chrono::steady_clock::now();
+    }
+
+    worker_pool.reserve(options.worker_threads);
+    for (std::size_t i = 0; i < options.worker_threads; ++i) {
+        worker_pool.emplace_back([this]() {
+            run_worker(true);
+            });
+    }
+}
+
+
+template<class Traits>
+BasicQueue<Traits>::~BasicQueue() {
+    // An exception of the worker threads that nobody took from wait_idle() is dropped.
+    try {
+        shutdown();
+    }
+    catch (...) {
+    }
+
+    WorkerDeque* deque = worker_deques.load(std::memory_order_relaxed);
+    while (deque) {
+        delete std::exchange(deque, deque->next);
+    }
+
+    TraceBuffer* buffer = trace_buffers.load(std::memory_order_relaxed);
+    while (buffer) {
+        delete std::exchange(buffer, buffer->next);
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wait_idle() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idle.wait(lock, [this] {
+        return unfinished_tasks.load(std::memory_order_acquire) == 0;
+        });
+    if (worker_error) std::rethrow_exception(std::exchange(worker_error, nullptr));
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::shutdown() {
+    if (worker_pool.empty()) return;
+
+    shutting_down.store(true, std::memory_order_release);
+    wake_all_workers();
+
+    for (auto& thread : worker_pool) {
+        thread.join();
+    }
+    worker_pool.clear();
+
+    std::lock_guard<std::mutex> guard(mtx);
+    if (worker_error) std::rethrow_exception(std::exchange(worker_error, nullptr));
+}
+
+
+template<class Traits>
+std::size_t BasicQueue<Traits>::tracked_resources() const {
+    std::size_t tracked = 0;
+    for (std::size_t i = 0; i < shard_count; ++i) {
+        std::lock_guard<std::mutex> guard(shards[i].mtx);
+        tracked += shards[i].resources.size();
+
+        if constexpr (dense) {
+            for (std::size_t block = i * dense_shard_block; block < dense_resources; block += shard_count * dense_shard_block) {
+                for (std::size_t r = block; r < std::min(block + dense_shard_block, dense_resources); ++r) {
+                    if (dense_states[r].last_writer || dense_states[r].readers) ++tracked;
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(range_table->mtx);
+        tracked += range_table->intervals.size();
+    }
+
+    std::lock_guard<std::mutex> guard(node_table->mtx);
+    for (const typename NodeTable::Node& node : node_table->nodes) {
+        if (node.state.last_writer || node.state.readers) ++tracked;
+    }
+    return tracked;
+}
+
+
+template<class Traits>
+resource_node BasicQueue<Traits>::add_resource_node() {
+    std::lock_guard<std::mutex> guard(node_table->mtx);
+    const auto index = static_cast<std::uint32_t>(node_table->nodes.size());
+    node_table->nodes.push_back({ index, 0, {} });
+    return resource_node{ index };
+}
+
+
+template<class Traits>
+resource_node BasicQueue<Traits>::add_resource_node(resource_node parent) {
+    std::lock_guard<std::mutex> guard(node_table->mtx);
+    if (parent.index >= node_table->nodes.size()) throw std::out_of_range("the parent is not a resource node of this queue");
+    const auto index = static_cast<std::uint32_t>(node_table->nodes.size());
+    node_table->nodes.push_back({ parent.index, 0, {} });
+    return resource_node{ index };
+}
+
+
+template<class Traits>
+QueueStats BasicQueue<Traits>::stats() const requires Traits::statistics {
+    QueueStats snapshot;
+    const auto sum = [](std::uint64_t& total, const std::atomic<std::uint64_t>& counter) {
+        total += counter.load(std::memory_order_relaxed);
+        };
+
+    std::uint64_t lock_wait_ns = 0;
+    std::uint64_t parked_ns = 0;
+    for (std::size_t i = 0; i < stats_shard_count; ++i) {
+        const StatsShard& shard = stats_shards[i];
+        sum(snapshot.tasks_enqueued, shard.tasks_enqueued);
+        sum(snapshot.tasks_started, shard.tasks_started);
+        sum(snapshot.tasks_completed, shard.tasks_completed);
+        sum(snapshot.dependency_edges, shard.dependency_edges);
+        sum(lock_wait_ns, shard.lock_wait_ns);
+        sum(parked_ns, shard.parked_ns);
+        for (std::size_t b = 0; b < QueueStats::latency_buckets; ++b) sum(snapshot.ready_latency[b], shard.ready_latency[b]);
+    }
+    snapshot.lock_wait = std::chrono::nanoseconds(lock_wait_ns);
+    snapshot.parked = std::chrono::nanoseconds(parked_ns);
+
+    snapshot.ready_tasks = ready_size.load(std::memory_order_relaxed);
+    for (const WorkerDeque* deque = worker_deques.load(std::memory_order_acquire); deque; deque = deque->next) {
+        snapshot.ready_tasks += deque->size.load(std::memory_order_relaxed);
+    }
+    snapshot.unfinished_tasks = unfinished_tasks.load(std::memory_order_relaxed);
+    snapshot.parked_workers = waiting_workers.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+
+template<class Traits>
+std::unique_lock<std::mutex> BasicQueue<Traits>::lock_shared() {
+    if constexpr (statistics) {
+        std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            const auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            const std::chrono::nanoseconds waited = std::chrono::steady_clock::now() - start;
+            StatsShard::add(stats_shard().lock_wait_ns, static_cast<std::uint64_t>(waited.count()));
+        }
+        return lock;
+    }
+    else {
+        return std::unique_lock<std::mutex>(mtx);
+    }
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::StatsShard& BasicQueue<Traits>::stats_shard() const {
+    static std::atomic<std::size_t> threads{ 0 };
+    static thread_local const std::size_t thread_index = threads.fetch_add(1, std::memory_order_relaxed);
+    return stats_shards[thread_index % stats_shard_count];
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::count_edges() const {
+    if constexpr (statistics) {
+        StatsShard::add(stats_shard().dependency_edges, std::exchange(TaskControl::added_edges, 0));
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::count_start(const TaskControl* tc) const {
+    StatsShard& shard = stats_shard();
+    StatsShard::add(shard.tasks_started, 1);
+
+    const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - tc->ready_time;
+    const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 0));
+    const std::size_t bucket = std::min<std::size_t>(std::bit_width(ns), QueueStats::latency_buckets - 1);
+    StatsShard::add(shard.ready_latency[bucket], 1);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wait_parked(ParkingSlot* slot) const {
+    if constexpr (statistics) {
+        const auto start = std::chrono::steady_clock::now();
+        slot->wait_for_signal();
+        const std::chrono::nanoseconds parked_for = std::chrono::steady_clock::now() - start;
+        StatsShard::add(stats_shard().parked_ns, static_cast<std::uint64_t>(parked_for.count()));
+    }
+    else {
+        slot->wait_for_signal();
+    }
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::TraceBuffer& BasicQueue<Traits>::trace_buffer() {
+    // The log of the queue the thread used last, the lookup only walks the list when the queue changes.
+    static thread_local std::uint64_t cached_queue = 0;
+    static thread_local TraceBuffer* cached = nullptr;
+
+    if (cached_queue != trace_queue) {
+        const std::thread::id self = std::this_thread::get_id();
+        cached = trace_buffers.load(std::memory_order_acquire);
+        while (cached && cached->owner != self) cached = cached->next;
+
+        if (!cached) {
+            cached = new TraceBuffer(trace_buffer_capacity);
+            cached->thread_index = traced_threads.fetch_add(1, std::memory_order_relaxed);
+            cached->next = trace_buffers.load(std::memory_order_relaxed);
+            while (!trace_buffers.compare_exchange_weak(cached->next, cached, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+        cached_queue = trace_queue;
+    }
+
+    TaskControl::edge_trace = cached;
+    return *cached;
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::record_trace(TraceKind kind, std::uint64_t task, std::uint64_t dependent) {
+    // The log is looked up first, the first event of a thread allocates it.
+    TraceBuffer& buffer = trace_buffer();
+    const std::chrono::nanoseconds time = std::chrono::steady_clock::now() - trace_start;
+    buffer.events.push({ kind, task, dependent, time.count() });
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::write_trace(std::ostream& out) const requires Traits::tracing {
+    // The times of a task in nanoseconds, negative when the event was not logged (or was overwritten).
+    struct TaskTimes {
+        std::uint64_t task;
+        std::int64_t enqueued = -1;
+        std::int64_t ready = -1;
+        std::int64_t started = -1;
+        std::int64_t finished = -1;
+        std::size_t thread = 0;
+    };
+    struct Edge {
+        std::uint64_t task;
+        std::uint64_t dependent;
+    };
+
+    std::vector<TaskTimes> times;
+    std::vector<Edge> edges;
+    std::size_t threads = 0;
+    std::uint64_t overwritten = 0;
+
+    for (const TraceBuffer* buffer = trace_buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        threads = std::max(threads, buffer->thread_index + 1);
+        overwritten += buffer->events.overwritten();
+        buffer->events.for_each([&](const TraceEvent& event) {
+            if (event.kind == TraceKind::edge) {
+                edges.push_back({ event.task, event.dependent });
+                return;
+            }
+            TaskTimes& entry = times.emplace_back(TaskTimes{ event.task });
+            switch (event.kind) {
+            case TraceKind::enqueued: entry.enqueued = event.time; break;
+            case TraceKind::ready: entry.ready = event.time; break;
+            case TraceKind::started: entry.started = event.time; entry.thread = buffer->thread_index; break;
+            case TraceKind::finished: entry.finished = event.time; break;
+            case TraceKind::edge: break;
+            }
+            });
+    }
+
+    // Every event got its own entry, the entries of a task are merged into the first one.
+    std::ranges::sort(times, {}, &TaskTimes::task);
+    std::size_t merged = 0;
+    for (std::size_t i = 0; i < times.size(); ++merged) {
+        TaskTimes& entry = times[merged] = times[i];
+        for (++i; i < times.size() && times[i].task == entry.task; ++i) {
+            entry.enqueued = std::max(entry.enqueued, times[i].enqueued);
+            entry.ready = std::max(entry.ready, times[i].ready);
+            entry.finished = std::max(entry.finished, times[i].finished);
+            if (times[i].started >= 0) {
+                entry.started = times[i].started;
+                entry.thread = times[i].thread;
+            }
+        }
+    }
+    times.resize(merged);
+    std::ranges::sort(edges, {}, &Edge::task);
+
+    const auto find_task = [&times](std::uint64_t task) -> const TaskTimes* {
+        const auto it = std::ranges::lower_bound(times, task, {}, &TaskTimes::task);
+        return it != times.end() && it->task == task ? &*it : nullptr;
+        };
+    const auto ran = [](const TaskTimes* entry) {
+        return entry && entry->started >= 0 && entry->finished >= 0;
+        };
+    const auto write_micros = [&out](std::int64_t ns) {
+        const std::int64_t fraction = ns % 1000;
+        out << ns / 1000 << '.' << (fraction < 100 ? (fraction < 10 ? "00" : "0") : "") << fraction;
+        };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"overwritten_events\":" << overwritten << "},\"traceEvents\":[";
+    const char* separator = "\n";
+
+    for (std::size_t thread = 0; thread < threads; ++thread) {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+        separator = ",\n";
+    }
+
+    for (const TaskTimes& entry : times) {
+        if (!ran(&entry)) continue;
+        out << separator << "{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":0,\"tid\":" << entry.thread << ",\"ts\":";
+        write_micros(entry.started);
+        out << ",\"dur\":";
+        write_micros(entry.finished - entry.started);
+        out << ",\"args\":{\"task\":" << entry.task;
+        if (entry.enqueued >= 0 && entry.ready >= entry.enqueued) {
+            out << ",\"waiting_for_dependencies_us\":";
+            write_micros(entry.ready - entry.enqueued);
+        }
+        if (entry.ready >= 0) {
+            out << ",\"waiting_for_worker_us\":";
+            write_micros(entry.started - entry.ready);
+        }
+        out << "}}";
+    }
+
+    // Read groups are not tasks, their edges are followed through to the tasks behind them.
+    std::uint64_t flow = 0;
+    std::vector<std::uint64_t> pending;
+    std::vector<std::uint64_t> visited;
+    std::vector<const TaskTimes*> dependents;
+    for (const TaskTimes& entry : times) {
+        if (!ran(&entry)) continue;
+
+        pending.assign(1, entry.task);
+        visited.clear();
+        dependents.clear();
+        while (!pending.empty()) {
+            const std::uint64_t node = pending.back();
+            pending.pop_back();
+
+            auto it = std::ranges::lower_bound(edges, node, {}, &Edge::task);
+            for (; it != edges.end() && it->task == node; ++it) {
+                if (const TaskTimes* dependent = find_task(it->dependent)) {
+                    if (ran(dependent)) dependents.push_back(dependent);
+                }
+                else if (std::ranges::find(visited, it->dependent) == visited.end()) {
+                    visited.push_back(it->dependent);
+                    pending.push_back(it->dependent);
+                }
+            }
+        }
+
+        std::ranges::sort(dependents);
+        dependents.erase(std::unique(dependents.begin(), dependents.end()), dependents.end());
+        for (const TaskTimes* dependent : dependents) {
+            ++flow;
+            out << separator << "{\"name\":\"dependency\",\"cat\":\"dependency\",\"ph\":\"s\",\"id\":" << flow
+                << ",\"pid\":0,\"tid\":" << entry.thread << ",\"ts\":";
+            write_micros(entry.started);
+            out << "},\n{\"name\":\"dependency\",\"cat\":\"dependency\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << flow
+                << ",\"pid\":0,\"tid\":" << dependent->thread << ",\"ts\":";
+            write_micros(dependent->started);
+            out << "}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+
+template<class Traits>
+std::size_t BasicQueue<Traits>::shard_of(resource_id r) const {
+    if constexpr (dense) return static_cast<std::size_t>(r / dense_shard_block) & (shard_count - 1);
+    return static_cast<std::size_t>(static_cast<std::uint64_t>(ResourceHash{}(r)) >> 58) & (shard_count - 1);
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::shard_mask BasicQueue<Traits>::shards_of(std::span<const resource_id> ids) const {
+    shard_mask mask = 0;
+    for (resource_id r : ids) mask |= shard_mask{ 1 } << shard_of(r);
+    return mask;
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::lock_shards(shard_mask mask) {
+    // Always in the increasing order, so that two multi-shard enqueues cannot deadlock.
+    for (; mask != 0; mask &= mask - 1) {
+        shards[std::countr_zero(mask)].mtx.lock();
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::unlock_shards(shard_mask mask) {
+    for (; mask != 0; mask &= mask - 1) {
+        shards[std::countr_zero(mask)].mtx.unlock();
+    }
+}
+
+
+template<class Traits>
+class BasicQueue<Traits>::ShardLock {
+public:
+    ShardLock(BasicQueue& queue, shard_mask mask) : queue(queue), mask(mask) { queue.lock_shards(mask); }
+    ~ShardLock() { queue.unlock_shards(mask); }
+
+    ShardLock(const ShardLock&) = delete;
+    ShardLock& operator=(const ShardLock&) = delete;
+
+private:
+    BasicQueue& queue;
+    shard_mask mask;
+};
+
+
+template<class Traits>
+void BasicQueue<Traits>::push_ready(TaskRef tc) {
+    push_ready(std::span<TaskRef>(&tc, 1));
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::push_ready(std::span<TaskRef> tasks) {
+    WorkerDeque* local = local_deque();
+
+    // Only tasks of normal priority may bypass the bands, the others are taken out first
+    //  and the rest is compacted in order.
+    const auto is_normal = [](const TaskRef& tc) {
+        return tc->priority.load(std::memory_order_relaxed) == Priority::normal;
+        };
+    if ((local || lock_free_ready) && !std::ranges::all_of(tasks, is_normal)) {
+        std::size_t kept = 0;
+        {
+            const std::unique_lock<std::mutex> guard = lock_shared();
+            for (TaskRef& tc : tasks) {
+                if (is_normal(tc)) {
+                    tasks[kept++] = std::move(tc);
+                }
+                else {
+                    push_ready_locked(std::move(tc));
+                }
+            }
+        }
+        tasks = tasks.first(kept);
+        if (tasks.empty()) return;
+    }
+
+    if (local) {
+        local->push(tasks);
+        return;
+    }
+
+    std::size_t pushed = 0;
+    if (lock_free_ready) {
+        while (pushed < tasks.size() && lock_free_ready->try_push(std::move(tasks[pushed]))) ++pushed;
+        if (pushed == tasks.size()) return;
+    }
+
+    const std::unique_lock<std::mutex> guard = lock_shared();
+    for (; pushed < tasks.size(); ++pushed) push_ready_locked(std::move(tasks[pushed]));
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::push_ready_locked(TaskRef tc) {
+    const Priority priority = tc->priority.load(std::memory_order_relaxed);
+
+    if (scheduling == Scheduling::critical_path && priority == Priority::normal) {
+        const std::uint64_t path_length = tc->path_length.load(std::memory_order_relaxed);
+        tc->ranked_path_length.store(path_length, std::memory_order_relaxed);
+        ranked_tasks.push_back({ path_length, ranked_sequence++, std::move(tc) });
+        std::push_heap(ranked_tasks.begin(), ranked_tasks.end());
+    }
+    else {
+        ready_tasks.push(static_cast<std::size_t>(priority), std::move(tc));
+    }
+
+    ready_size.store(ready_tasks.size() + ranked_tasks.size(), std::memory_order_relaxed);
+    urgent_size.store(ready_tasks.size_from(static_cast<std::size_t>(Priority::high)), std::memory_order_relaxed);
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::try_pop_task(TaskRef& tc, WorkerDeque* local) {
+    return try_pop_fifo(tc, Priority::high) || try_pop_ready(tc, local) || try_pop_fifo(tc, Priority::low);
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::try_pop_ready(TaskRef& tc, WorkerDeque* local) {
+    if (local && local->pop(tc)) return true;
+    if (lock_free_ready && lock_free_ready->try_pop(tc)) return true;
+    return local && try_steal(tc, local);
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::try_pop_fifo(TaskRef& tc, Priority min_priority) {
+    const auto& hint = min_priority > Priority::normal ? urgent_size : ready_size;
+    if (hint.load(std::memory_order_relaxed) == 0) return false;
+
+    const std::unique_lock<std::mutex> guard = lock_shared();
+    return pop_fifo_locked(tc, min_priority);
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::pop_fifo_locked(TaskRef& tc, Priority min_priority) {
+    const auto pop_ranked = [this, &tc]() {
+        if (ranked_tasks.empty()) return false;
+        std::pop_heap(ranked_tasks.begin(), ranked_tasks.end());
+        tc = std::move(ranked_tasks.back().tc);
+        ranked_tasks.pop_back();
+        return true;
+        };
+
+    // The heap comes right after the normal band, which stays empty while it is used.
+    if (!ready_tasks.pop(tc, static_cast<std::size_t>(std::max(min_priority, Priority::normal)))
+        && !(min_priority <= Priority::normal && pop_ranked())
+        && !ready_tasks.pop(tc, static_cast<std::size_t>(min_priority))) {
+        return false;
+    }
+
+    ready_size.store(ready_tasks.size() + ranked_tasks.size(), std::memory_order_relaxed);
+    urgent_size.store(ready_tasks.size_from(static_cast<std::size_t>(Priority::high)), std::memory_order_relaxed);
+    return true;
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::has_ready_tasks() const {
+    if (ready_size.load(std::memory_order_relaxed) > 0) return true;
+    if (lock_free_ready && !lock_free_ready->empty()) return true;
+
+    for (WorkerDeque* deque = worker_deques.load(std::memory_order_acquire); deque; deque = deque->next) {
+        if (deque->size.load(std::memory_order_relaxed) > 0) return true;
+    }
+    return false;
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::try_steal(TaskRef& tc, WorkerDeque* thief) {
+    // Start right after the thief, so that the thieves do not all pick the same victim.
+    WorkerDeque* head = worker_deques.load(std::memory_order_acquire);
+    WorkerDeque* start = thief->next ? thief->next : head;
+
+    for (WorkerDeque* victim = start; victim; victim = victim->next) {
+        if (victim != thief && victim->steal(tc)) return true;
+    }
+    for (WorkerDeque* victim = head; victim != start; victim = victim->next) {
+        if (victim != thief && victim->steal(tc)) return true;
+    }
+    return false;
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wake_workers(std::size_t count) {
+    if (count == 0) return;
+
+    // Pairs with the fence in park(): either the parking worker sees the pushed task,
+    //  or we see the worker listed and wake it up. A spinning worker stops being counted
+    //  as one before that fence, so it is not missed either.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::size_t spinning = spinning_workers.load(std::memory_order_acquire);
+    if (spinning >= count) return;
+    count -= spinning;
+
+    const std::size_t waiting = waiting_workers.load(std::memory_order_relaxed);
+    if (waiting == 0) return;
+
+    // A worker lists itself before it checks for tasks once more, so it is either taken off
+    //  the list here or it finds the task itself.
+    count = std::min(count, waiting);
+    while (count > 0) {
+        ParkingSlot* woken[wake_batch];
+        std::size_t taken = 0;
+        {
+            std::lock_guard<std::mutex> guard(parking_mtx);
+            while (taken < std::min(count, wake_batch) && !parked.empty()) {
+                woken[taken++] = parked.back();
+                parked.pop_back();
+            }
+            waiting_workers.store(parked.size(), std::memory_order_relaxed);
+        }
+
+        signal_slots(std::span(woken, taken));
+        if (taken < wake_batch) return;
+        count -= taken;
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wake_all_workers() {
+    wake_workers(std::numeric_limits<std::size_t>::max());
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wake_worker(ParkingSlot* slot) {
+    {
+        std::lock_guard<std::mutex> guard(parking_mtx);
+        const auto it = std::ranges::find(parked, slot);
+        if (it == parked.end()) return;
+        parked.erase(it);
+        waiting_workers.store(parked.size(), std::memory_order_relaxed);
+    }
+    signal_slots(std::span(&slot, 1));
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::signal_slots(std::span<ParkingSlot* const> slots) {
+    for (ParkingSlot* slot : slots) {
+        slot->signal.store(1, std::memory_order_release);
+        slot->signal.notify_one();
+    }
+}
+
+
+template<class Traits>
+template<class Condition>
+bool BasicQueue<Traits>::park(ParkingSlot* slot, Condition&& condition) {
+    {
+        std::lock_guard<std::mutex> guard(parking_mtx);
+        parked.push_back(slot);
+        waiting_workers.store(parked.size(), std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in wake_workers(): either the producer sees this worker listed,
+    //  or the condition sees the pushed task.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (condition()) {
+        {
+            std::lock_guard<std::mutex> guard(parking_mtx);
+            const auto it = std::ranges::find(parked, slot);
+            if (it != parked.end()) {
+                parked.erase(it);
+                waiting_workers.store(parked.size(), std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // A producer has taken the slot already and is about to signal it. The wakeup was meant
+        //  for a task this worker may not have taken, so it is passed on.
+        wait_parked(slot);
+        if (has_ready_tasks()) wake_workers(1);
+        return true;
+    }
+
+    wait_parked(slot);
+    return false;
+}
+
+
+template<class Traits>
+bool BasicQueue<Traits>::spin_for_task(TaskRef& tc, WorkerDeque* local, std::size_t rounds, bool stays_idle) {
+    // The pause doubles up to 64 cpu_relax() calls, afterwards the core is given away
+    //  between the rounds, so that spinning does not starve the producers on a busy machine.
+    constexpr std::size_t max_pause_shift = 6;
+    constexpr std::size_t yield_after = 16;
+
+    for (std::size_t round = 0; round < rounds; ++round) {
+        if (try_pop_task(tc, local)) return true;
+        if (!stays_idle && unfinished_tasks.load(std::memory_order_acquire) == 0) return false;
+
+        if (round < yield_after) {
+            for (std::size_t i = std::size_t{ 1 } << std::min(round, max_pause_shift); i > 0; --i) cpu_relax();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    return false;
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::cpu_relax() noexcept {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::release_dependency(TaskRef tc, std::vector<TaskRef>& new_ready, TaskRef* continuation) {
+    if (tc->dependency_count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    if (tc->read_group) {
+        // There is nothing to run, the group finishes right away.
+        finish_task(tc.get(), new_ready, continuation);
+        return;
+    }
+    mark_ready(tc.get());
+
+    if (continuation && !*continuation && tc->priority.load(std::memory_order_relaxed) == Priority::normal) {
+        *continuation = std::move(tc);
+    }
+    else {
+        new_ready.push_back(std::move(tc));
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::mark_ready(TaskControl* tc) {
+    if constexpr (statistics) tc->ready_time = std::chrono::steady_clock::now();
+    if constexpr (tracing) record_trace(TraceKind::ready, tc->trace_id);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::finish_task(TaskControl* tc, std::vector<TaskRef>& new_ready, TaskRef* continuation) {
+    {
+        std::lock_guard<std::mutex> guard(tc->mtx);
+        tc->finished.store(true, std::memory_order_release);
+    }
+    // Nobody follows the links of a finished task.
+    tc->predecessors.clear();
+
+    // Pairs with the fence in wait_for(): either the waiting thread sees the flag, or we see it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tc->waited.load(std::memory_order_acquire)) {
+        tc->finished.notify_all();
+        // No helping worker is added once the flag is set under the lock. Every one of them either
+        //  is on the parked list by now, or it sees the flag once it is.
+        for (ParkingSlot* slot : tc->waiters) wake_worker(slot);
+    }
+
+    // No edges are added once the task is finished, so the dependents can be walked without the lock.
+    for (TaskRef& dep : tc->dependents) release_dependency(std::move(dep), new_ready, continuation);
+    tc->dependents.clear();
+}
+
+
+template<class Traits>
+std::uint64_t BasicQueue<Traits>::next_enqueue_epoch() {
+    // Threads take the epochs in blocks, so that they do not contend on the counter.
+    constexpr std::uint64_t block_size = 1024;
+    static std::atomic<std::uint64_t> next_block{ 1 };
+    static thread_local std::uint64_t next = 0;
+    static thread_local std::uint64_t block_end = 0;
+
+    if (next == block_end) {
+        next = next_block.fetch_add(block_size, std::memory_order_relaxed);
+        block_end = next + block_size;
+    }
+    return next++;
+}
+
+
+template<class Traits>
+template<class Range>
+void BasicQueue<Traits>::append_unique_ids(std::vector<resource_id>& buffer, Range&& list) {
+    if constexpr (dense) {
+        append_dense_ids<dense_resources>(buffer, std::forward<Range>(list));
+    }
+    else {
+        append_sorted_ids(buffer, std::forward<Range>(list));
+    }
+}
+
+
+template<class Traits>
+template<class Range>
+decltype(auto) BasicQueue<Traits>::listed_ids(Range&& list) {
+    if constexpr (lists_ranges<Range> || lists_nodes<Range>) {
+        return std::ranges::empty_view<resource_id>();
+    }
+    else {
+        return std::forward<Range>(list);
+    }
+}
+
+
+template<class Traits>
+template<std::size_t Slot, class Range>
+std::span<const resource_range> BasicQueue<Traits>::listed_ranges(Range&& list) {
+    if constexpr (!lists_ranges<Range>) {
+        return {};
+    }
+    else {
+        static thread_local std::vector<resource_range> buffer;
+        buffer.clear();
+        for (const resource_range& range : list) {
+            if (range.begin < range.end) buffer.push_back(range);
+        }
+
+        std::ranges::sort(buffer, {}, &resource_range::begin);
+        std::size_t merged = 0;
+        for (const resource_range& range : buffer) {
+            if (merged > 0 && range.begin <= buffer[merged - 1].end) {
+                buffer[merged - 1].end = std::max(buffer[merged - 1].end, range.end);
+            }
+            else {
+                buffer[merged++] = range;
+            }
+        }
+        buffer.resize(merged);
+        return buffer;
+    }
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::ResourceState& BasicQueue<Traits>::state_of(resource_id r) {
+    if constexpr (dense) return dense_states[r];
+    return shards[shard_of(r)].track(r);
+}
+
+
+template<class Traits>
+template<std::size_t Slot, class Range>
+std::span<const resource_node> BasicQueue<Traits>::listed_nodes(Range&& list) {
+    if constexpr (!lists_nodes<Range>) {
+        return {};
+    }
+    else {
+        static thread_local std::vector<resource_node> buffer;
+        buffer.assign(std::ranges::begin(list), std::ranges::end(list));
+        return buffer;
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::depend_on(const TaskRef& tc, const TaskRef& dep, std::uint64_t epoch) {
+    // The edge is added before the table drops its reference, which may be the last one.
+    // A concurrent enqueue() may overwrite the stamp in between, that only costs a redundant edge.
+    if (dep->dependency_epoch.load(std::memory_order_relaxed) == epoch) return;
+    dep->dependency_epoch.store(epoch, std::memory_order_relaxed);
+    dep->add_dependent_linked(tc);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::close_read_group(const TaskRef& readers) {
+    if (!readers->read_group || !readers->open_group) return;
+
+    // The group cannot release anything but the writer, which is still held.
+    readers->open_group = false;
+    std::vector<TaskRef> no_ready;
+    release_dependency(readers, no_ready);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::record_task(const TaskRef& tc, std::span<const resource_id> write_ids, std::span<const resource_id> read_ids) {
+    const std::uint64_t epoch = next_enqueue_epoch();
+
+    for (resource_id r : write_ids) {
+        ResourceState& state = state_of(r);
+
+        if (state.readers) {
+            // A single edge to the readers, however many there are, then a group is closed.
+            depend_on(tc, state.readers, epoch);
+            close_read_group(state.readers);
+            state.readers = TaskRef();
+        }
+        else if (state.last_writer) {
+            depend_on(tc, state.last_writer, epoch);
+        }
+
+        state.last_writer = tc;
+    }
+
+    for (resource_id r : read_ids) {
+        ResourceState& state = state_of(r);
+        // Reading what the task writes itself is no dependency.
+        if (state.last_writer.get() == tc.get()) continue;
+
+        if (state.last_writer) depend_on(tc, state.last_writer, epoch);
+
+        // Most resources are read once between two writes, a group is only made for the second reader.
+        // The first one joins it unless it has already finished.
+        if (!state.readers) {
+            state.readers = tc;
+            continue;
+        }
+        if (!state.readers->read_group) {
+            TaskRef group = TaskControl::create_read_group();
+            state.readers->add_dependent_linked(group);
+            state.readers = std::move(group);
+        }
+        tc->add_dependent_linked(state.readers);
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::record_ranges(const TaskRef& tc, std::span<const resource_range> write_ranges, std::span<const resource_range> read_ranges) {
+    IntervalMap<resource_id, ResourceState>& intervals = range_table->intervals;
+    const std::uint64_t epoch = next_enqueue_epoch();
+
+    const auto is_open_group = [](const TaskRef& readers) {
+        return readers && readers->read_group && readers->open_group;
+        };
+    const auto same = [](const ResourceState& a, const ResourceState& b) {
+        return a.last_writer.get() == b.last_writer.get() && a.readers.get() == b.readers.get();
+        };
+
+    intervals.sweep(sweep_steps * (write_ranges.size() + read_ranges.size()), [&is_open_group](const ResourceState& state) {
+        if (is_open_group(state.readers)) return state.readers->dependency_count.load(std::memory_order_acquire) == 1;
+        if (state.readers) return state.readers->finished.load(std::memory_order_acquire);
+        return !state.last_writer || state.last_writer->finished.load(std::memory_order_acquire);
+        });
+
+    for (const resource_range& range : write_ranges) {
+        intervals.update(range.begin, range.end, [&](ResourceState& state) {
+            if (state.readers) {
+                depend_on(tc, state.readers, epoch);
+                close_read_group(state.readers);
+                state.readers = TaskRef();
+            }
+            else if (state.last_writer) {
+                depend_on(tc, state.last_writer, epoch);
+            }
+            });
+        intervals.assign(range.begin, range.end, ResourceState{ tc, TaskRef() });
+        intervals.coalesce(range.begin, range.end, same);
+    }
+
+    for (const resource_range& range : read_ranges) {
+        // Neighbouring intervals mostly list the same readers, the group made for the reader of one
+        //  interval is reused by the next ones with the same reader, and the task joins every group once.
+        TaskRef grouped_reader;
+        TaskRef reader_group;
+        const TaskControl* joined = nullptr;
+
+        intervals.update(range.begin, range.end, [&](ResourceState& state) {
+            if (state.last_writer.get() == tc.get()) return;
+            if (state.last_writer) depend_on(tc, state.last_writer, epoch);
+
+            if (!state.readers) {
+                state.readers = tc;
+                return;
+            }
+            // A single reader or a closed group joins a new group, just as the single reader does with ids.
+            if (!is_open_group(state.readers)) {
+                if (state.readers.get() != grouped_reader.get()) {
+                    grouped_reader = state.readers;
+                    reader_group = TaskControl::create_read_group();
+                    state.readers->add_dependent_linked(reader_group);
+                }
+                state.readers = reader_group;
+            }
+            if (state.readers.get() != joined) {
+                tc->add_dependent_linked(state.readers);
+                joined = state.readers.get();
+            }
+            });
+        intervals.coalesce(range.begin, range.end, same);
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::record_nodes(const TaskRef& tc, std::span<const resource_node> write_nodes, std::span<const resource_node> read_nodes) {
+    using Access = typename NodeTable::Access;
+    std::vector<typename NodeTable::Node>& nodes = node_table->nodes;
+    const std::uint64_t epoch = next_enqueue_epoch();
+
+    // Every node the task reaches once, with all its accesses to it or-ed together.
+    static thread_local std::vector<std::pair<std::uint32_t, std::uint8_t>> accesses;
+    accesses.clear();
+    const auto add_path = [&nodes](resource_node node, Access all, Access below) {
+        accesses.emplace_back(node.index, all);
+        for (std::uint32_t i = node.index; nodes[i].parent != i;) {
+            i = nodes[i].parent;
+            accesses.emplace_back(i, below);
+        }
+        };
+    for (resource_node node : write_nodes) add_path(node, NodeTable::write_all, NodeTable::write_below);
+    for (resource_node node : read_nodes) add_path(node, NodeTable::read_all, NodeTable::read_below);
+    std::ranges::sort(accesses);
+
+    for (std::size_t i = 0; i < accesses.size();) {
+        typename NodeTable::Node& node = nodes[accesses[i].first];
+        std::uint8_t access = 0;
+        for (const std::uint32_t index = accesses[i].first; i < accesses.size() && accesses[i].first == index; ++i) {
+            access |= accesses[i].second;
+        }
+        ResourceState& state = node.state;
+
+        // Conflicting readers become the barrier that the new ones wait for, like a writer.
+        if (state.readers && (access == NodeTable::write_all || (node.shared | access) == NodeTable::write_all)) {
+            depend_on(tc, state.readers, epoch);
+            close_read_group(state.readers);
+            state.last_writer = std::move(state.readers);
+            state.readers = TaskRef();
+            node.shared = 0;
+        }
+        else if (state.last_writer) {
+            depend_on(tc, state.last_writer, epoch);
+        }
+
+        if (access == NodeTable::write_all) {
+            state.last_writer = tc;
+            continue;
+        }
+
+        if (!state.readers) {
+            state.readers = tc;
+        }
+        else {
+            if (!state.readers->read_group) {
+                TaskRef group = TaskControl::create_read_group();
+                state.readers->add_dependent_linked(group);
+                state.readers = std::move(group);
+            }
+            tc->add_dependent_linked(state.readers);
+        }
+        node.shared |= access;
+    }
+}
+
+
+template<class Traits>
+template<class Value, class Skip, class Visit>
+void BasicQueue<Traits>::walk_predecessors(TaskControl* tc, Value value, std::size_t budget, Skip&& skip, Visit&& visit) {
+    struct Pending {
+        TaskControl::Predecessor link;
+        Value value;
+    };
+    static thread_local std::vector<Pending> pending;
+
+    const auto push_links = [&](const TaskControl* node, const Value& next) {
+        for (const auto& link : node->predecessors) {
+            if (!skip(link.tc, next)) pending.push_back({ link, next });
+        }
+        };
+
+    // The task is still held by the caller, its links are complete and stay valid.
+    push_links(tc, value);
+
+    for (; !pending.empty() && budget > 0; --budget) {
+        auto [link, next] = pending.back();
+        pending.pop_back();
+
+        // A task cannot finish, and so be recycled, while its lock is held. A finished one has dropped its links.
+        std::lock_guard<std::mutex> guard(link.tc->mtx);
+        if (link.tc->finished.load(std::memory_order_acquire)) continue;
+        if (link.tc->generation.load(std::memory_order_relaxed) != link.generation) continue;
+
+        if (visit(link.tc, next)) push_links(link.tc, next);
+    }
+    pending.clear();
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::inherit_priority(TaskControl* tc) {
+    static thread_local std::vector<TaskRef> redispatched;
+
+    walk_predecessors(tc, tc->priority.load(std::memory_order_relaxed), std::numeric_limits<std::size_t>::max(),
+        [](const TaskControl* node, Priority priority) {
+            return node->priority.load(std::memory_order_relaxed) >= priority;
+        },
+        [](TaskControl* node, Priority priority) {
+            if (node->priority.load(std::memory_order_relaxed) >= priority) return false;
+            node->priority.store(priority, std::memory_order_relaxed);
+
+            // A queued task takes its old place in the ready queue, so it has to be pushed once more.
+            if (node->queued()) {
+                node->references.fetch_add(1, std::memory_order_relaxed);
+                redispatched.emplace_back(node);
+            }
+            return true;
+        });
+
+    if (redispatched.empty()) return;
+
+    const std::size_t count = redispatched.size();
+    push_ready(redispatched);
+    redispatched.clear();
+    wake_workers(count);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::extend_critical_paths(TaskControl* tc) {
+    static thread_local std::vector<TaskRef> redispatched;
+
+    const std::uint64_t cost = cost_of(tc->cost_class);
+    tc->cost.store(cost, std::memory_order_relaxed);
+    tc->path_length.store(cost, std::memory_order_relaxed);
+
+    walk_predecessors(tc, cost, critical_path_walk,
+        [](const TaskControl* node, std::uint64_t tail) {
+            return node->path_length.load(std::memory_order_relaxed) >= node->cost.load(std::memory_order_relaxed) + tail;
+        },
+        [](TaskControl* node, std::uint64_t& tail) {
+            tail += node->cost.load(std::memory_order_relaxed);
+            if (node->path_length.load(std::memory_order_relaxed) >= tail) return false;
+            node->path_length.store(tail, std::memory_order_relaxed);
+
+            // The head of a chain is usually ready before the rest of the chain is enqueued. It is pushed
+            //  once more whenever its path doubled, so a chain costs a logarithmic number of copies.
+            if (node->queued() && tail >= 2 * node->ranked_path_length.load(std::memory_order_relaxed)) {
+                node->references.fetch_add(1, std::memory_order_relaxed);
+                redispatched.emplace_back(node);
+            }
+            return true;
+        });
+
+    if (redispatched.empty()) return;
+
+    const std::size_t count = redispatched.size();
+    push_ready(redispatched);
+    redispatched.clear();
+    wake_workers(count);
+}
+
+
+template<class Traits>
+std::uint64_t BasicQueue<Traits>::cost_of(cost_class_id cost_class) const {
+    const std::uint64_t estimate = cost_estimates[cost_class].load(std::memory_order_relaxed);
+    return estimate == 0 ? default_cost : estimate;
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::learn_cost(cost_class_id cost_class, std::chrono::nanoseconds elapsed) {
+    // Concurrent updates of one class may overwrite each other, which only loses a sample.
+    std::atomic<std::uint64_t>& estimate = cost_estimates[cost_class];
+    const auto sample = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(elapsed.count(), 1));
+    const std::uint64_t previous = estimate.load(std::memory_order_relaxed);
+    estimate.store(previous == 0 ? sample : previous - previous / 8 + sample / 8, std::memory_order_relaxed);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::release_holds(std::span<TaskRef> tasks) {
+    // The ready tasks are moved to the front and pushed together.
+    std::size_t new_ready = 0;
+    for (TaskRef& tc : tasks) {
+        TaskRef held = std::move(tc);
+        if (held->dependency_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            mark_ready(held.get());
+            tasks[new_ready++] = std::move(held);
+        }
+    }
+
+    publish_ready(tasks.first(new_ready));
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::publish_ready(std::span<TaskRef> tasks) {
+    if (current_worker.queue == this && current_worker.deferred) {
+        for (TaskRef& tc : tasks) current_worker.deferred->push_back(std::move(tc));
+        return;
+    }
+
+    push_ready(tasks);
+    wake_workers(tasks.size());
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::publish_deferred() {
+    std::vector<TaskRef>* deferred = current_worker.queue == this ? current_worker.deferred : nullptr;
+    if (!deferred || deferred->empty()) return;
+
+    const std::size_t count = deferred->size();
+    push_ready(*deferred);
+    deferred->clear();
+    wake_workers(count);
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::WorkerDeque* BasicQueue<Traits>::acquire_worker_deque() {
+    for (WorkerDeque* deque = worker_deques.load(std::memory_order_acquire); deque; deque = deque->next) {
+        bool expected = false;
+        if (!deque->in_use.load(std::memory_order_relaxed) && deque->in_use.compare_exchange_strong(expected, true)) {
+            return deque;
+        }
+    }
+
+    auto deque = new WorkerDeque;
+    deque->in_use.store(true, std::memory_order_relaxed);
+    deque->next = worker_deques.load(std::memory_order_relaxed);
+    while (!worker_deques.compare_exchange_weak(deque->next, deque, std::memory_order_release, std::memory_order_relaxed)) {}
+    return deque;
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::ParkingSlot* BasicQueue<Traits>::acquire_parking_slot() {
+    std::lock_guard<std::mutex> guard(parking_mtx);
+    for (auto& slot : parking_slots) {
+        if (!slot->in_use) {
+            slot->in_use = true;
+            return slot.get();
+        }
+    }
+
+    parking_slots.push_back(std::make_unique<ParkingSlot>());
+    parking_slots.back()->in_use = true;
+    return parking_slots.back().get();
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::release_parking_slot(ParkingSlot* slot) {
+    std::lock_guard<std::mutex> guard(parking_mtx);
+    slot->in_use = false;
+}
+
+
+template<class Traits>
+typename BasicQueue<Traits>::WorkerDeque* BasicQueue<Traits>::local_deque() const {
+    return current_worker.queue == this ? current_worker.deque : nullptr;
+}
+
+
+template<class Traits>
+template<std::invocable Func, resource_list WRange, resource_list RRange>
+void BasicQueue<Traits>::enqueue(Func&& task, WRange&& writes, RRange&& reads, Priority priority, cost_class_id cost_class) {
+    TaskRef tc = TaskControl::create(std::forward<Func>(task));
+    tc->priority.store(priority, std::memory_order_relaxed);
+    tc->cost_class = cost_class;
+    enqueue_task(std::move(tc), std::forward<WRange>(writes), std::forward<RRange>(reads));
+}
+
+
+template<class Traits>
+template<std::invocable Func, resource_list WRange, resource_list RRange>
+typename BasicQueue<Traits>::TaskHandle<std::decay_t<std::invoke_result_t<std::decay_t<Func>&>>> BasicQueue<Traits>::enqueue_with_handle(Func&& task, WRange&& writes, RRange&& reads, Priority priority, cost_class_id cost_class) {
+    using T = std::decay_t<std::invoke_result_t<std::decay_t<Func>&>>;
+    using Result = typename TaskHandle<T>::Result;
+
+    auto result = std::make_shared<Result>();
+
+    TaskRef tc = TaskControl::create([func = std::forward<Func>(task), result]() mutable {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                func();
+            }
+            else {
+                result->value.emplace(func());
+            }
+        }
+        catch (...) {
+            result->error = std::current_exception();
+        }
+        });
+    tc->priority.store(priority, std::memory_order_relaxed);
+    tc->cost_class = cost_class;
+
+    TaskHandle<T> handle(this, tc, std::move(result));
+    enqueue_task(std::move(tc), std::forward<WRange>(writes), std::forward<RRange>(reads));
+    return handle;
+}
+
+
+template<class Traits>
+template<resource_list WRange, resource_list RRange>
+void BasicQueue<Traits>::enqueue(Coroutine coroutine, WRange&& writes, RRange&& reads, Priority priority, cost_class_id cost_class) {
+    typename Coroutine::promise_type& promise = coroutine.handle.promise();
+    promise.priority = priority;
+    promise.cost_class = cost_class;
+    enqueue_step(std::exchange(coroutine.handle, nullptr), std::forward<WRange>(writes), std::forward<RRange>(reads), priority, cost_class);
+}
+
+
+template<class Traits>
+template<resource_list WRange, resource_list RRange>
+typename BasicQueue<Traits>::Acquire<std::decay_t<WRange>, std::decay_t<RRange>> BasicQueue<Traits>::acquire(WRange&& writes, RRange&& reads) {
+    return Acquire<std::decay_t<WRange>, std::decay_t<RRange>>(this, std::forward<WRange>(writes), std::forward<RRange>(reads));
+}
+
+
+template<class Traits>
+template<class WRange, class RRange>
+void BasicQueue<Traits>::enqueue_step(std::coroutine_handle<> handle, WRange&& writes, RRange&& reads, Priority priority, cost_class_id cost_class) {
+    enqueue(CoroutineStep(handle), std::forward<WRange>(writes), std::forward<RRange>(reads), priority, cost_class);
+}
+
+
+template<class Traits>
+template<class WRange, class RRange>
+void BasicQueue<Traits>::enqueue_task(TaskRef tc, WRange&& writes, RRange&& reads) {
+    using WIds = decltype(listed_ids(std::forward<WRange>(writes)));
+    using RIds = decltype(listed_ids(std::forward<RRange>(reads)));
+
+    const UniqueIds<0, WIds> write_ids(listed_ids(std::forward<WRange>(writes)));
+    const UniqueIds<1, RIds> read_ids(listed_ids(std::forward<RRange>(reads)));
+    const std::span<const resource_id> write_span(write_ids.begin(), write_ids.size());
+    const std::span<const resource_id> read_span(read_ids.begin(), read_ids.size());
+    const std::span<const resource_range> write_ranges = listed_ranges<0>(writes);
+    const std::span<const resource_range> read_ranges = listed_ranges<1>(reads);
+    const std::span<const resource_node> write_nodes = listed_nodes<0>(writes);
+    const std::span<const resource_node> read_nodes = listed_nodes<1>(reads);
+
+    const shard_mask touched = shards_of(write_span) | shards_of(read_span);
+
+    unfinished_tasks.fetch_add(1, std::memory_order_relaxed);
+    if constexpr (statistics) StatsShard::add(stats_shard().tasks_enqueued, 1);
+    if constexpr (tracing) record_trace(TraceKind::enqueued, tc->trace_id);
+
+    {
+        const ShardLock shard_lock(*this, touched);
+        record_task(tc, write_span, read_span);
+        if (!write_ranges.empty() || !read_ranges.empty()) {
+            std::lock_guard<std::mutex> guard(range_table->mtx);
+            record_ranges(tc, write_ranges, read_ranges);
+        }
+        if (!write_nodes.empty() || !read_nodes.empty()) {
+            std::lock_guard<std::mutex> guard(node_table->mtx);
+            record_nodes(tc, write_nodes, read_nodes);
+        }
+    }
+    count_edges();
+
+    inherit_priority(tc.get());
+    if (scheduling == Scheduling::critical_path) extend_critical_paths(tc.get());
+
+    std::vector<TaskRef>& released = released_buffer();
+    release_dependency(std::move(tc), released);
+    publish_ready(released);
+    released.clear();
+}
+
+
+template<class Traits>
+template<std::ranges::input_range Batch>
+void BasicQueue<Traits>::enqueue_batch(Batch&& batch) {
+    BatchBuffers& buffers = batch_buffers();
+    const typename BatchBuffers::Reset reset{ buffers };
+    shard_mask touched = 0;
+
+    for (auto&& descriptor : batch) {
+        auto&& [task, writes, reads] = descriptor;
+
+        const std::size_t writes_begin = buffers.ids.size();
+        append_unique_ids(buffers.ids, writes);
+        const std::size_t writes_end = buffers.ids.size();
+        append_unique_ids(buffers.ids, reads);
+
+        touched |= shards_of(std::span<const resource_id>(buffers.ids).subspan(writes_begin));
+
+        if constexpr (moves_elements<Batch>) {
+            buffers.tasks.push_back(TaskControl::create(std::move(task)));
+        }
+        else {
+            buffers.tasks.push_back(TaskControl::create(task));
+        }
+        buffers.bounds.push_back({ writes_end, buffers.ids.size() });
+    }
+
+    if (buffers.tasks.empty()) return;
+    unfinished_tasks.fetch_add(buffers.tasks.size(), std::memory_order_relaxed);
+    if constexpr (statistics) StatsShard::add(stats_shard().tasks_enqueued, buffers.tasks.size());
+    if constexpr (tracing) {
+        for (const TaskRef& tc : buffers.tasks) record_trace(TraceKind::enqueued, tc->trace_id);
+    }
+
+    // Tasks of the batch depend on each other through the tables like any other tasks,
+    //  they are all recorded before the first one can be made ready.
+    const std::span<const resource_id> ids(buffers.ids);
+    std::size_t begin = 0;
+
+    {
+        const ShardLock shard_lock(*this, touched);
+        for (std::size_t i = 0; i < buffers.tasks.size(); ++i) {
+            const auto [writes_end, reads_end] = buffers.bounds[i];
+            record_task(buffers.tasks[i], ids.subspan(begin, writes_end - begin), ids.subspan(writes_end, reads_end - writes_end));
+            begin = reads_end;
+        }
+    }
+    count_edges();
+
+    for (const TaskRef& tc : buffers.tasks) {
+        inherit_priority(tc.get());
+        if (scheduling == Scheduling::critical_path) extend_critical_paths(tc.get());
+    }
+
+    release_holds(buffers.tasks);
+}
+
+
+template<class Traits>
+template<std::ranges::input_range Tasks>
+void BasicQueue<Traits>::submit(const TaskGraph& graph, Tasks&& tasks) {
+    BatchBuffers& buffers = batch_buffers();
+    const typename BatchBuffers::Reset reset{ buffers };
+    std::vector<TaskRef>& nodes = buffers.tasks;
+
+    for (auto&& task : tasks) {
+        if constexpr (moves_elements<Tasks>) {
+            nodes.push_back(TaskControl::create(std::move(task)));
+        }
+        else {
+            nodes.push_back(TaskControl::create(task));
+        }
+    }
+
+    if (nodes.size() != graph.size()) throw std::invalid_argument("submit() got a different number of tasks than the graph has");
+    if (nodes.empty()) return;
+    unfinished_tasks.fetch_add(nodes.size(), std::memory_order_relaxed);
+    if constexpr (statistics) {
+        StatsShard& shard = stats_shard();
+        StatsShard::add(shard.tasks_enqueued, nodes.size());
+        StatsShard::add(shard.dependency_edges, graph.dependents.size());
+    }
+    if constexpr (tracing) {
+        for (const TaskRef& tc : nodes) record_trace(TraceKind::enqueued, tc->trace_id);
+    }
+
+    // Nobody else sees the new tasks yet, the edges between them are set up without their locks.
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i]->dependency_count.store(1 + graph.in_degrees[i], std::memory_order_relaxed);
+        for (std::size_t e = graph.dependents_begin[i]; e < graph.dependents_begin[i + 1]; ++e) {
+            nodes[i]->dependents.push_back(nodes[graph.dependents[e]]);
+            if constexpr (tracing) record_trace(TraceKind::edge, nodes[i]->trace_id, nodes[graph.dependents[e]]->trace_id);
+        }
+    }
+
+    // The recorded tasks only wait for earlier ones, so the critical paths are summed up backwards.
+    if (scheduling == Scheduling::critical_path) {
+        for (std::size_t i = nodes.size(); i-- > 0;) {
+            std::uint64_t tail = 0;
+            for (const TaskRef& dependent : nodes[i]->dependents) {
+                tail = std::max(tail, dependent->path_length.load(std::memory_order_relaxed));
+            }
+            const std::uint64_t cost = cost_of(nodes[i]->cost_class);
+            nodes[i]->cost.store(cost, std::memory_order_relaxed);
+            nodes[i]->path_length.store(cost + tail, std::memory_order_relaxed);
+        }
+    }
+
+    if (!graph.exits.empty()) {
+        std::lock_guard<std::mutex> guard(graphs_mtx);
+        std::vector<TaskRef>* found = graph_exits.find(graph.id);
+        if (!found) {
+            graph_exits.sweep(sweep_steps, [](const std::vector<TaskRef>& exits) {
+                return std::ranges::all_of(exits, [](const TaskRef& tc) { return tc->finished.load(std::memory_order_acquire); });
+                });
+            found = &graph_exits[graph.id];
+        }
+        std::vector<TaskRef>& exits = *found;
+
+        if (!exits.empty()) {
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                for (std::size_t e = graph.previous_begin[i]; e < graph.previous_begin[i + 1]; ++e) {
+                    exits[graph.previous[e]]->add_dependent(nodes[i]);
+                }
+            }
+        }
+
+        exits.resize(graph.exits.size());
+        for (std::size_t k = 0; k < graph.exits.size(); ++k) exits[k] = nodes[graph.exits[k]];
+    }
+    count_edges();
+
+    release_holds(nodes);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::serve() {
+    run_worker(false);
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::run_worker(bool owned_thread) {
+    WorkerDeque* local = scheduling == Scheduling::work_stealing ? acquire_worker_deque() : nullptr;
+
+    ParkingSlot* slot = acquire_parking_slot();
+
+    // A task may serve another queue (or this one) recursively, the outer context is restored on exit.
+    std::vector<TaskRef> deferred;
+    const WorkerContext outer_worker = std::exchange(current_worker, WorkerContext{ this, local, defer_nested_enqueues ? &deferred : nullptr, slot, owned_thread });
+    struct ContextRestore {
+        BasicQueue* queue;
+        WorkerContext outer;
+        WorkerDeque* local;
+        ParkingSlot* slot;
+        ~ContextRestore() {
+            current_worker = outer;
+            if (local) local->in_use.store(false, std::memory_order_release);
+            queue->release_parking_slot(slot);
+        }
+    } restore{ this, outer_worker, local, slot };
+
+    // Idle windows of this worker, adapted by every spin.
+    std::size_t spin_rounds = max_spin_rounds;
+
+    while (true) {
+        TaskRef tc;
+        if (!try_pop_task(tc, local)) {
+            const bool spun = spin_rounds > 0;
+            if (spun) {
+                spinning_workers.fetch_add(1, std::memory_order_relaxed);
+
+                if (spin_for_task(tc, local, spin_rounds, owned_thread)) {
+                    spin_rounds = std::min(spin_rounds * 2, max_spin_rounds);
+
+                    // Producers may have skipped waking anyone because of this worker,
+                    //  so the last spinner passes the duty on if there is more work.
+                    if (spinning_workers.fetch_sub(1, std::memory_order_acq_rel) == 1 && has_ready_tasks()) {
+                        wake_workers(1);
+                    }
+                }
+                else {
+                    spin_rounds = std::max<std::size_t>(spin_rounds / 2, 1);
+                }
+            }
+
+            if (!tc) {
+                // Producers that see the worker as spinning no more see it listed or their task is found.
+                if (spun) spinning_workers.fetch_sub(1, std::memory_order_release);
+
+                const auto done = [this, owned_thread]() {
+                    return unfinished_tasks.load(std::memory_order_acquire) == 0
+                        && (!owned_thread || shutting_down.load(std::memory_order_acquire));
+                    };
+                while (!park(slot, [this, &tc, local, &done] { return try_pop_task(tc, local) || done(); })) {}
+
+                if (!tc) return;
+            }
+        }
+
+        run_task(std::move(tc), local);
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::run_task(TaskRef tc, WorkerDeque* local) {
+    for (std::size_t depth = 0; tc; ++depth) {
+        if (tc->dispatched.exchange(true, std::memory_order_acq_rel)) return;
+        if constexpr (statistics) count_start(tc.get());
+        if constexpr (tracing) record_trace(TraceKind::started, tc->trace_id);
+
+        // A throwing task is finished like any other, its exception is only passed on afterwards.
+        std::exception_ptr error;
+        try {
+            if (scheduling == Scheduling::critical_path) {
+                const auto start = std::chrono::steady_clock::now();
+                tc->task();
+                learn_cost(tc->cost_class, std::chrono::steady_clock::now() - start);
+            }
+            else {
+                tc->task();
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        // The captures are released right away, the task itself may outlive its completion in the tables.
+        tc->task.reset();
+        if constexpr (statistics) StatsShard::add(stats_shard().tasks_completed, 1);
+        if constexpr (tracing) record_trace(TraceKind::finished, tc->trace_id);
+
+        std::vector<TaskRef>& released = released_buffer();
+        TaskRef next;
+        finish_task(tc.get(), released, depth < max_continuations ? &next : nullptr);
+
+        // The tasks enqueued by the finished one are pushed in the same batch as the ones it released.
+        if (std::vector<TaskRef>* deferred = current_worker.deferred) {
+            for (TaskRef& child : *deferred) released.push_back(std::move(child));
+            deferred->clear();
+        }
+
+        // Only a sole ready task runs right here, only while no task of a higher priority waits,
+        //  and only if the finished one did not throw, which ends this chain.
+        if (next && (!released.empty() || urgent_size.load(std::memory_order_relaxed) > 0 || error)) {
+            released.push_back(std::move(next));
+        }
+
+        std::size_t new_ready = released.size();
+        push_ready(released);
+        released.clear();
+
+        // Kept before the task counts as finished, so that wait_idle() finds it.
+        if (error && current_worker.owned_thread) {
+            std::lock_guard<std::mutex> guard(mtx);
+            if (!worker_error) worker_error = error;
+            error = nullptr;
+        }
+
+        if (unfinished_tasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            wake_all_workers();
+            std::lock_guard<std::mutex> guard(mtx);
+            idle.notify_all();
+        }
+        else if (!next) {
+            // Locally pushed tasks keep one for this worker, the rest is left for the thieves.
+            if (local && new_ready > 0) new_ready--;
+            wake_workers(new_ready);
+        }
+
+        if (error) std::rethrow_exception(error);
+        tc = std::move(next);
+    }
+}
+
+
+template<class Traits>
+void BasicQueue<Traits>::wait_for(TaskControl* tc) {
+    if (tc->finished.load(std::memory_order_acquire)) return;
+
+    if (current_worker.queue != this) {
+        tc->waited.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!tc->finished.load(std::memory_order_acquire)) {
+            tc->finished.wait(false, std::memory_order_acquire);
+        }
+        return;
+    }
+
+    // The waited task may be among the deferred ones, and blocking here could leave the tasks
+    //  that the waited one needs without a worker.
+    publish_deferred();
+    WorkerDeque* local = current_worker.deque;
+    {
+        std::lock_guard<std::mutex> guard(tc->mtx);
+        if (tc->finished.load(std::memory_order_relaxed)) return;
+        tc->waiters.push_back(current_worker.parking);
+        tc->waited.store(true, std::memory_order_release);
+    }
+
+    while (!tc->finished.load(std::memory_order_acquire)) {
+        TaskRef next;
+        if (!try_pop_task(next, local)) {
+            // Parks like an idle worker, woken up by a new ready task or by the waited one finishing.
+            if (!park(current_worker.parking, [this, tc, &next, local] {
+                return try_pop_task(next, local) || tc->finished.load(std::memory_order_acquire);
+                })) {
+                continue;
+            }
+
+            if (!next) return;
+        }
 
+        run_task(std::move(next), local);
     }
 }
 
 
-#endif // QUEUE_HPP
\ No newline at end of file
+#endif // QUEUE_HPP
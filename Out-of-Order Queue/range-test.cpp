@@ -0,0 +1,244 @@
+///**
+// * Tests the resource ranges: overlapping ranges of different tasks are ordered like the ids
+// *  they span would be, and the neighbouring intervals left by the same task are merged again.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <algorithm>
+//#include <atomic>
+//#include <iostream>
+//#include <random>
+//#include <string>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//TEST_CASE(split_read_group, "writers of parts of a range read by several tasks wait for the readers only") {
+//    Queue queue(QueueOptions{ .worker_threads = 1 });
+//    std::string log;
+//
+//    queue.enqueue([&log]() { log += "r"; }, writes(), reads(resource_range{ 0, 100 }));
+//    queue.enqueue([&log]() { log += "r"; }, writes(), reads(resource_range{ 0, 100 }));
+//    queue.enqueue([&log]() { log += "a"; }, writes(resource_range{ 0, 50 }), reads());
+//
+//    // The first writer does not wait for a write of the other half.
+//    queue.wait_idle();
+//    if (log != "rra") {
+//        PRINT_INDENTED("The tasks ran in the order \"" << log << "\", expected \"rra\"");
+//        return false;
+//    }
+//
+//    queue.enqueue([&log]() { log += "s"; }, writes(), reads(resource_range{ 40, 60 }));
+//    queue.enqueue([&log]() { log += "b"; }, writes(resource_range{ 50, 100 }), reads());
+//    queue.enqueue([&log]() { log += "c"; }, writes(), reads(resource_range{ 0, 100 }));
+//    queue.wait_idle();
+//
+//    if (log != "rrasbc") {
+//        PRINT_INDENTED("The tasks ran in the order \"" << log << "\", expected \"rrasbc\"");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//namespace {
+//
+//    // Every page counts the writes, a task checks that it sees the writes enqueued before it and no later ones.
+//    struct Pages {
+//        std::vector<std::size_t> writes;
+//        std::atomic<std::size_t> errors{ 0 };
+//
+//        explicit Pages(std::size_t pages) : writes(pages, 0) {}
+//    };
+//
+//} // namespace
+//
+//static bool random_ranges_test(QueueOptions options, std::size_t workers) {
+//    constexpr std::size_t pages = 256;
+//    constexpr std::size_t tasks = 20'000;
+//    constexpr std::size_t max_length = 48;
+//
+//    Queue queue(options);
+//    Pages state(pages);
+//    std::vector<std::size_t> expected(pages, 0);
+//    std::mt19937 random(42);
+//
+//    const auto pick = [&random, pages, max_length]() {
+//        const std::size_t begin = random() % pages;
+//        const std::size_t end = std::min(pages, begin + 1 + random() % max_length);
+//        return resource_range{ begin, end };
+//        };
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        const resource_range written = pick();
+//        const resource_range read = pick();
+//
+//        // Every fifth task only writes, every fifth only reads both of the ranges.
+//        const bool reading = i % 5 != 0;
+//        const bool writing = i % 5 != 1;
+//
+//        std::vector<std::size_t> seen;
+//        if (reading) {
+//            seen.assign(expected.begin() + read.begin, expected.begin() + read.end);
+//            if (!writing) seen.insert(seen.end(), expected.begin() + written.begin, expected.begin() + written.end);
+//        }
+//        if (writing) {
+//            for (resource_id p = written.begin; p < written.end; ++p) expected[p]++;
+//        }
+//
+//        const auto task = [&state, written, read, seen = std::move(seen), reading, writing]() {
+//            if (reading) {
+//                std::size_t s = 0;
+//                for (resource_id p = read.begin; p < read.end; ++p) {
+//                    if (state.writes[p] != seen[s++]) state.errors++;
+//                }
+//                for (resource_id p = written.begin; !writing && p < written.end; ++p) {
+//                    if (state.writes[p] != seen[s++]) state.errors++;
+//                }
+//            }
+//            if (writing) {
+//                for (resource_id p = written.begin; p < written.end; ++p) state.writes[p]++;
+//            }
+//            };
+//
+//        if (!reading) {
+//            queue.enqueue(task, writes(written), reads());
+//        }
+//        else if (!writing) {
+//            queue.enqueue(task, writes(), reads(read, written));
+//        }
+//        else {
+//            queue.enqueue(task, writes(written), reads(read));
+//        }
+//    }
+//
+//    std::vector<std::thread> threads;
+//    threads.reserve(workers);
+//
+//    for (std::size_t i = 0; i < workers; ++i) {
+//        threads.emplace_back([&queue]() {
+//            queue.serve();
+//            });
+//    }
+//
+//    for (auto& thread : threads) {
+//        thread.join();
+//    }
+//
+//    if (state.errors.load() != 0) {
+//        PRINT_INDENTED(state.errors.load() << " reads of a page saw another number of writes than was enqueued before them");
+//        return false;
+//    }
+//    if (state.writes != expected) {
+//        PRINT_INDENTED("The pages were not written the expected number of times");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(random_ranges, "overlapping ranges written and read at random, served by a single worker") {
+//    return random_ranges_test(QueueOptions{}, 1);
+//}
+//
+//TEST_CASE(random_ranges_in_workers, "overlapping ranges written and read at random, served by multiple workers") {
+//    return random_ranges_test(QueueOptions{}, 4);
+//}
+//
+//TEST_CASE(random_ranges_stealing, "overlapping ranges written and read at random, served by multiple work stealing workers") {
+//    return random_ranges_test(QueueOptions{ .scheduling = Scheduling::work_stealing }, 4);
+//}
+//
+//TEST_CASE(intervals_merged, "a range written over many small ones leaves a single interval") {
+//    constexpr std::size_t pages = 4'096;
+//
+//    Queue queue;
+//
+//    for (std::size_t p = 0; p < pages; ++p) {
+//        queue.enqueue([]() {}, writes(resource_range{ p, p + 1 }), reads());
+//    }
+//    queue.enqueue([]() {}, writes(resource_range{ 0, pages }), reads());
+//
+//    // The pages written one by one are merged as well, all of them by the same task.
+//    if (queue.tracked_resources() != 1) {
+//        PRINT_INDENTED("The table keeps " << queue.tracked_resources() << " intervals, expected 1");
+//        return false;
+//    }
+//
+//    queue.serve();
+//    return true;
+//}
+//
+//TEST_CASE(ranges_and_ids_apart, "a range does not conflict with the ids it spans listed singly") {
+//    Queue queue(QueueOptions{ .worker_threads = 2 });
+//    std::atomic<bool> written{ false };
+//    std::string log;
+//
+//    // The range writer waits for the writer of the id, it would never finish if the id waited for the range.
+//    queue.enqueue([&written]() {
+//        while (!written.load()) std::this_thread::yield();
+//        }, writes(resource_range{ 0, 100 }), reads());
+//    queue.enqueue([&written]() {
+//        written = true;
+//        }, writes(50), reads());
+//    queue.enqueue([&log]() { log += "a"; }, writes(), reads(resource_range{ 40, 60 }));
+//    queue.enqueue([&log]() { log += "b"; }, writes(resource_range{ 10, 20 }), reads(50));
+//    queue.wait_idle();
+//
+//    if (log != "ab" && log != "ba") {
+//        PRINT_INDENTED("The tasks ran as \"" << log << "\", expected both of them once");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!split_read_group()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_ranges()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_ranges_in_workers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!random_ranges_stealing()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!intervals_merged()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!ranges_and_ids_apart()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,58 @@
+#ifndef RING_DEQUE_HPP
+#define RING_DEQUE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Double-ended queue in one circular buffer that only ever grows, so that a queue
+//  which is repeatedly filled and drained stops allocating once it reaches its peak size.
+// T has to be default-constructible, free slots hold moved-from values.
+template<class T>
+class RingDeque {
+public:
+    bool empty() const noexcept { return count == 0; }
+    std::size_t size() const noexcept { return count; }
+
+    void push_back(T&& value) {
+        if (count == capacity) grow();
+        buffer[(head + count) & (capacity - 1)] = std::move(value);
+        ++count;
+    }
+
+    // The deque must not be empty.
+    T pop_back() {
+        --count;
+        return std::move(buffer[(head + count) & (capacity - 1)]);
+    }
+
+    // The deque must not be empty.
+    T pop_front() {
+        T value = std::move(buffer[head]);
+        head = (head + 1) & (capacity - 1);
+        --count;
+        return value;
+    }
+
+private:
+    void grow() {
+        const std::size_t new_capacity = capacity == 0 ? 16 : capacity * 2;
+        auto new_buffer = std::make_unique<T[]>(new_capacity);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            new_buffer[i] = std::move(buffer[(head + i) & (capacity - 1)]);
+        }
+
+        buffer = std::move(new_buffer);
+        capacity = new_capacity;
+        head = 0;
+    }
+
+    std::unique_ptr<T[]> buffer;
+    std::size_t capacity = 0;
+    std::size_t head = 0;
+    std::size_t count = 0;
+};
+
+
+#endif // RING_DEQUE_HPP
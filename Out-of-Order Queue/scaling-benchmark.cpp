@@ -0,0 +1,189 @@
+///**
+// * Measures dispatch throughput (tasks per second) of the queue for 1 to N worker threads.
+// * Tasks are tiny, so the numbers are dominated by the cost of getting a task in and out of the queue.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <chrono>
+//#include <iostream>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//static constexpr std::size_t max_workers = 32;
+//static constexpr std::size_t lock_free_capacity = 1 << 16;
+//
+//namespace {
+//
+//    struct Configuration {
+//        const char* name;
+//        QueueOptions options;
+//    };
+//
+//    const Configuration configurations[] = {
+//        { "locked ready queue", QueueOptions{} },
+//        { "lock-free ready queue", QueueOptions{ .ready_queue_capacity = lock_free_capacity } },
+//        { "work stealing", QueueOptions{ .scheduling = Scheduling::work_stealing } },
+//    };
+//
+//    void tiny_work() {
+//        volatile std::size_t sink = 0;
+//        for (std::size_t i = 0; i < 64; ++i) {
+//            sink = sink + i;
+//        }
+//    }
+//
+//    // Runs the prepared queue with the given number of workers and returns the achieved tasks per second.
+//    double serve_with_workers(Queue& queue, std::size_t workers, std::size_t tasks) {
+//        std::vector<std::thread> threads;
+//        threads.reserve(workers);
+//
+//        const auto start = std::chrono::steady_clock::now();
+//
+//        for (std::size_t i = 0; i < workers; ++i) {
+//            threads.emplace_back([&queue]() {
+//                queue.serve();
+//                });
+//        }
+//
+//        for (auto& thread : threads) {
+//            thread.join();
+//        }
+//
+//        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+//        return static_cast<double>(tasks) / elapsed.count();
+//    }
+//
+//} // namespace
+//
+//template<typename Prepare>
+//static bool scaling_benchmark(Prepare&& prepare, std::size_t tasks) {
+//    for (const Configuration& configuration : configurations) {
+//        PRINT_INDENTED(configuration.name << ':');
+//        PUSH_INDENT();
+//
+//        for (std::size_t workers = 1; workers <= max_workers; workers *= 2) {
+//            Queue queue(configuration.options);
+//            std::atomic<std::size_t> done_tasks{ 0 };
+//
+//            prepare(queue, done_tasks);
+//            const double rate = serve_with_workers(queue, workers, tasks);
+//
+//            if (done_tasks.load() != tasks) {
+//                PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << done_tasks.load());
+//                return false;
+//            }
+//
+//            PRINT_INDENTED(workers << " workers: " << static_cast<std::size_t>(rate) << " tasks/s");
+//        }
+//
+//        POP_INDENT();
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(independent_tasks, "tasks without any resources, every task is ready right away") {
+//    constexpr std::size_t tasks = 200'000;
+//
+//    return scaling_benchmark([](Queue& queue, std::atomic<std::size_t>& done_tasks) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                tiny_work();
+//                done_tasks.fetch_add(1, std::memory_order_relaxed);
+//                }, writes(), reads());
+//        }
+//        }, tasks);
+//}
+//
+//TEST_CASE(independent_chains, "64 write chains, every completion releases the next task of its chain") {
+//    constexpr std::size_t chains = 64;
+//    constexpr std::size_t tasks = 200'000;
+//
+//    return scaling_benchmark([](Queue& queue, std::atomic<std::size_t>& done_tasks) {
+//        for (std::size_t i = 0; i < tasks; ++i) {
+//            queue.enqueue([&done_tasks]() {
+//                tiny_work();
+//                done_tasks.fetch_add(1, std::memory_order_relaxed);
+//                }, writes(static_cast<resource_id>(i % chains)), reads());
+//        }
+//        }, tasks);
+//}
+//
+//namespace {
+//
+//    // Every task releases Fanout children from inside its body until the tree is Depth levels deep.
+//    template<std::size_t Fanout>
+//    class FanoutTask {
+//    public:
+//        FanoutTask(Queue& queue, std::atomic<std::size_t>& done_tasks, std::size_t node, std::size_t depth)
+//            : queue_(&queue), done_tasks_(&done_tasks), node_(node), depth_(depth) {
+//        }
+//
+//        void operator()() {
+//            tiny_work();
+//            done_tasks_->fetch_add(1, std::memory_order_relaxed);
+//
+//            if (depth_ == 0) {
+//                return;
+//            }
+//
+//            for (std::size_t i = 0; i < Fanout; ++i) {
+//                const auto child = node_ * Fanout + i + 1;
+//                queue_->enqueue(FanoutTask(*queue_, *done_tasks_, child, depth_ - 1), writes(static_cast<resource_id>(child)), reads(static_cast<resource_id>(node_)));
+//            }
+//        }
+//
+//    private:
+//        Queue* queue_;
+//        std::atomic<std::size_t>* done_tasks_;
+//        std::size_t node_;
+//        std::size_t depth_;
+//    };
+//
+//} // namespace
+//
+//TEST_CASE(recursive_fanout, "binary tree of tasks enqueued from inside the tasks") {
+//    constexpr std::size_t depth = 16;
+//    constexpr std::size_t tasks = (std::size_t{ 1 } << (depth + 1)) - 1;
+//
+//    return scaling_benchmark([](Queue& queue, std::atomic<std::size_t>& done_tasks) {
+//        queue.enqueue(FanoutTask<2>(queue, done_tasks, 0, depth), writes(resource_id{ 0 }), reads());
+//        }, tasks);
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!independent_tasks()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!independent_chains()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!recursive_fanout()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,172 @@
+#ifndef SORTED_IDS_HPP
+#define SORTED_IDS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sorted_ids_detail {
+
+    // Number of elements of ranges whose size is a part of their type, like std::array or
+    //  std::ranges::single_view, std::dynamic_extent for the others.
+    template<class Range>
+    inline constexpr std::size_t static_size = std::dynamic_extent;
+
+    template<class Range>
+        requires requires { std::tuple_size<Range>::value; }
+    inline constexpr std::size_t static_size<Range> = std::tuple_size_v<Range>;
+
+    template<class Range>
+        requires (!requires { std::tuple_size<Range>::value; }) && requires { std::integral_constant<std::size_t, Range::size()>{}; }
+    inline constexpr std::size_t static_size<Range> = Range::size();
+
+    // Ranges up to this size are normalized on the stack.
+    inline constexpr std::size_t max_stack_size = 1024;
+
+    // Every thread keeps one buffer per slot, it grows to the biggest range seen and is never shrunk.
+    template<class Id, std::size_t Slot>
+    std::vector<Id>& thread_buffer() {
+        static thread_local std::vector<Id> buffer;
+        return buffer;
+    }
+
+    // Sorts the ids and drops the duplicates, returns the number of the remaining ones.
+    template<class Id>
+    std::size_t sort_unique(Id* ids, std::size_t count) {
+        // Ids are often listed in order already, then the check is all it costs.
+        if (!std::is_sorted(ids, ids + count)) {
+            std::sort(ids, ids + count);
+        }
+        return static_cast<std::size_t>(std::unique(ids, ids + count) - ids);
+    }
+
+} // namespace sorted_ids_detail
+
+
+// Appends the ids of the range to the buffer, sorted and without duplicates among themselves,
+//  returns how many were appended.
+template<class Id, class Range>
+std::size_t append_sorted_ids(std::vector<Id>& buffer, Range&& range) {
+    const std::size_t first = buffer.size();
+    for (auto&& id : range) buffer.push_back(static_cast<Id>(id));
+
+    const std::size_t count = sorted_ids_detail::sort_unique(buffer.data() + first, buffer.size() - first);
+    buffer.resize(first + count);
+    return count;
+}
+
+
+// Appends the ids of the range to the buffer without duplicates among themselves, in the order
+//  they are listed, and returns how many were appended. The duplicates are found in a thread-local
+//  bitset of Bound bits instead of by sorting, it is cleared again afterwards.
+// Throws std::out_of_range for an id that is not below Bound, without appending any of the ids.
+template<std::size_t Bound, class Id, class Range>
+std::size_t append_dense_ids(std::vector<Id>& buffer, Range&& range) {
+    static thread_local std::vector<std::uint64_t> seen((Bound + 63) / 64, 0);
+
+    const std::size_t first = buffer.size();
+    const auto clear_seen = [&buffer, first]() {
+        for (std::size_t i = first; i < buffer.size(); ++i) seen[buffer[i] / 64] = 0;
+    };
+
+    for (auto&& id : range) {
+        const Id dense = static_cast<Id>(id);
+        if (static_cast<std::size_t>(dense) >= Bound) {
+            clear_seen();
+            buffer.resize(first);
+            throw std::out_of_range("dense resource id out of range");
+        }
+        std::uint64_t& word = seen[dense / 64];
+        const std::uint64_t bit = std::uint64_t{ 1 } << (dense % 64);
+        if (word & bit) continue;
+
+        word |= bit;
+        buffer.push_back(dense);
+    }
+
+    clear_seen();
+    return buffer.size() - first;
+}
+
+
+// The ids of a range, sorted and without duplicates.
+// Ranges of a size known at compile time are copied into an array inside the object,
+//  others into a thread-local buffer which is reused by the next object of the same slot,
+//  so only one object per slot may be alive on a thread at a time.
+template<class Id, std::size_t Slot, class Range>
+class SortedIds {
+public:
+    template<class R>
+    explicit SortedIds(R&& range);
+
+    SortedIds(const SortedIds&) = delete;
+    SortedIds& operator=(const SortedIds&) = delete;
+
+    const Id* begin() const noexcept { return ids; }
+    const Id* end() const noexcept { return ids + count; }
+    std::size_t size() const noexcept { return count; }
+
+private:
+    static constexpr std::size_t static_size = sorted_ids_detail::static_size<std::remove_cvref_t<Range>>;
+    static constexpr bool on_stack = static_size <= sorted_ids_detail::max_stack_size;
+
+    struct NoStorage {};
+    [[no_unique_address]] std::conditional_t<on_stack, std::array<Id, on_stack ? static_size : 0>, NoStorage> storage;
+
+    Id* ids = nullptr;
+    std::size_t count = 0;
+};
+
+
+template<class Id, std::size_t Slot, class Range>
+template<class R>
+SortedIds<Id, Slot, Range>::SortedIds(R&& range) {
+    if constexpr (on_stack) {
+        for (auto&& id : range) storage[count++] = static_cast<Id>(id);
+        ids = storage.data();
+        count = sorted_ids_detail::sort_unique(ids, count);
+    }
+    else {
+        std::vector<Id>& buffer = sorted_ids_detail::thread_buffer<Id, Slot>();
+        buffer.clear();
+        count = append_sorted_ids(buffer, std::forward<R>(range));
+        ids = buffer.data();
+    }
+}
+
+
+// The ids of a range below Bound, without duplicates but not sorted, in the thread-local buffer
+//  of the slot, with the same restriction as for SortedIds.
+template<class Id, std::size_t Slot, std::size_t Bound>
+class DenseIds {
+public:
+    template<class R>
+    explicit DenseIds(R&& range) {
+        std::vector<Id>& buffer = sorted_ids_detail::thread_buffer<Id, Slot>();
+        buffer.clear();
+        count = append_dense_ids<Bound>(buffer, std::forward<R>(range));
+        ids = buffer.data();
+    }
+
+    DenseIds(const DenseIds&) = delete;
+    DenseIds& operator=(const DenseIds&) = delete;
+
+    const Id* begin() const noexcept { return ids; }
+    const Id* end() const noexcept { return ids + count; }
+    std::size_t size() const noexcept { return count; }
+
+private:
+    Id* ids = nullptr;
+    std::size_t count = 0;
+};
+
+
+#endif // SORTED_IDS_HPP
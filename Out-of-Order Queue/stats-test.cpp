@@ -0,0 +1,193 @@
+///**
+// * Tests the statistics of a queue that counts them: the counters after the tasks have run,
+// *  the gauges of a queue that is not served, and the parked workers of the worker threads.
+// *
+// */
+//
+//#include <cstddef>
+//#include <cstdint>
+//
+//#include <atomic>
+//#include <chrono>
+//#include <functional>
+//#include <iostream>
+//#include <numeric>
+//#include <tuple>
+//#include <vector>
+//#include <thread>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    using StatsQueue = BasicQueue<StatisticsQueueTraits<>>;
+//
+//} // namespace
+//
+//TEST_CASE(counters, "tasks, edges and latencies are counted for single tasks, batches and graphs") {
+//    constexpr std::size_t chain = 100;
+//    constexpr std::size_t batch = 50;
+//    constexpr std::size_t graph_size = 3;
+//
+//    StatsQueue queue;
+//    std::size_t value{ 0 };
+//
+//    // Every writer of the chain waits for the one before it.
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([&value]() {
+//            ++value;
+//            }, writes(0), reads());
+//    }
+//
+//    const auto task = [&value]() {
+//        ++value;
+//        };
+//    std::vector<std::tuple<decltype(task), decltype(writes(1)), decltype(reads())>> batch_tasks;
+//    for (std::size_t i = 0; i < batch; ++i) {
+//        batch_tasks.emplace_back(task, writes(1), reads());
+//    }
+//    queue.enqueue_batch(std::move(batch_tasks));
+//
+//    // A chain of three tasks, two edges.
+//    TaskGraphRecorder recorder;
+//    for (std::size_t i = 0; i < graph_size; ++i) {
+//        recorder.add(writes(2), reads());
+//    }
+//    const TaskGraph graph = recorder.build();
+//    const std::vector<std::function<void()>> graph_tasks(graph_size, task);
+//    queue.submit(graph, graph_tasks);
+//
+//    queue.serve();
+//
+//    const std::uint64_t tasks = chain + batch + graph_size;
+//    const QueueStats stats = queue.stats();
+//
+//    if (value != tasks) {
+//        PRINT_INDENTED("Tasks were not executed the expected number of times, expected " << tasks << " but got " << value);
+//        return false;
+//    }
+//    if (stats.tasks_enqueued != tasks || stats.tasks_started != tasks || stats.tasks_completed != tasks) {
+//        PRINT_INDENTED("Counted " << stats.tasks_enqueued << " enqueued, " << stats.tasks_started << " started and "
+//            << stats.tasks_completed << " completed tasks, expected " << tasks);
+//        return false;
+//    }
+//
+//    const std::uint64_t edges = (chain - 1) + (batch - 1) + (graph_size - 1);
+//    if (stats.dependency_edges != edges) {
+//        PRINT_INDENTED("Counted " << stats.dependency_edges << " dependency edges, expected " << edges);
+//        return false;
+//    }
+//
+//    const std::uint64_t latencies = std::accumulate(stats.ready_latency.begin(), stats.ready_latency.end(), std::uint64_t{ 0 });
+//    if (latencies != tasks) {
+//        PRINT_INDENTED("The latency histogram counts " << latencies << " tasks, expected " << tasks);
+//        return false;
+//    }
+//    if (stats.ready_tasks != 0 || stats.unfinished_tasks != 0) {
+//        PRINT_INDENTED("The served queue has " << stats.ready_tasks << " ready and " << stats.unfinished_tasks << " unfinished tasks");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(gauges, "the ready and unfinished tasks of a queue that is not served yet") {
+//    constexpr std::size_t independent = 10;
+//    constexpr std::size_t chain = 5;
+//
+//    StatsQueue queue;
+//
+//    for (std::size_t i = 0; i < independent; ++i) {
+//        queue.enqueue([]() {}, writes(), reads());
+//    }
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([]() {}, writes(0), reads());
+//    }
+//
+//    const QueueStats stats = queue.stats();
+//    queue.serve();
+//
+//    // Only the head of the chain is ready.
+//    if (stats.ready_tasks != independent + 1 || stats.unfinished_tasks != independent + chain) {
+//        PRINT_INDENTED("The queue had " << stats.ready_tasks << " ready and " << stats.unfinished_tasks << " unfinished tasks, expected "
+//            << independent + 1 << " and " << independent + chain);
+//        return false;
+//    }
+//    if (stats.tasks_started != 0) {
+//        PRINT_INDENTED("Counted " << stats.tasks_started << " started tasks before serving");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(parked_workers, "idle worker threads are counted as parked, and so is the time they were") {
+//    constexpr std::size_t workers = 2;
+//    constexpr std::size_t tasks = 1'000;
+//
+//    StatsQueue queue(QueueOptions{ .worker_threads = workers });
+//
+//    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+//    while (queue.stats().parked_workers != workers) {
+//        if (std::chrono::steady_clock::now() > deadline) {
+//            PRINT_INDENTED("Only " << queue.stats().parked_workers << " of " << workers << " idle workers were parked");
+//            return false;
+//        }
+//        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+//    }
+//
+//    // The snapshots are taken while the workers run the tasks.
+//    std::atomic<std::size_t> runs{ 0 };
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&runs]() {
+//            runs++;
+//            }, writes(i % 4), reads());
+//        if (i % 100 == 0) queue.stats();
+//    }
+//    queue.wait_idle();
+//
+//    const QueueStats stats = queue.stats();
+//
+//    if (runs.load() != tasks || stats.tasks_completed != tasks) {
+//        PRINT_INDENTED("Ran " << runs.load() << " and counted " << stats.tasks_completed << " completed tasks, expected " << tasks);
+//        return false;
+//    }
+//    if (stats.parked.count() == 0) {
+//        PRINT_INDENTED("No time was counted for the parked workers");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!counters()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!gauges()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!parked_workers()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,186 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <concepts>
+#include <limits>
+#include <ranges>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sorted-ids.hpp"
+
+// Same as in queue.hpp.
+using resource_id = std::uintptr_t;
+
+template<class Traits>
+class BasicQueue;
+class TaskGraphRecorder;
+
+// Immutable dependency graph of a recorded sequence of tasks, submitted with Queue::submit().
+// The edges between the tasks and to the tasks of the previous submission of the same graph
+//  are computed once, so a submission costs O(tasks + edges) and does not look at the resources.
+class TaskGraph {
+public:
+    TaskGraph() = default;
+
+    // Number of recorded tasks.
+    std::size_t size() const noexcept { return in_degrees.size(); }
+
+private:
+    template<class Traits>
+    friend class BasicQueue;
+    friend class TaskGraphRecorder;
+
+    using index_t = std::uint32_t;
+
+    // Edges inside one submission: how many tasks every task waits for, and the tasks it releases.
+    std::vector<index_t> in_degrees;
+    std::vector<index_t> dependents_begin;
+    std::vector<index_t> dependents;
+
+    // Edges from the previous submission: the tasks it has to keep for the next one,
+    //  and for every task the positions in that list of the ones it waits for.
+    std::vector<index_t> exits;
+    std::vector<index_t> previous_begin;
+    std::vector<index_t> previous;
+
+    // Tells the submissions of different graphs apart, copies share it.
+    std::uint64_t id = 0;
+};
+
+
+// Records the resources of a sequence of tasks the way enqueue() would see them and builds the graph.
+// Like the queue, the graph makes a writer wait for all the readers since the previous write,
+//  but with a direct edge to each of them instead of a read group.
+class TaskGraphRecorder {
+public:
+    // Records the next task, returns its position in the graph.
+    template<std::ranges::input_range WRange, std::ranges::input_range RRange>
+        requires std::convertible_to<std::ranges::range_value_t<WRange>, resource_id>
+    && std::convertible_to<std::ranges::range_value_t<RRange>, resource_id>
+        std::size_t add(WRange&& writes, RRange&& reads);
+
+    std::size_t size() const noexcept { return bounds.size(); }
+
+    TaskGraph build() const;
+
+private:
+    using index_t = TaskGraph::index_t;
+    static constexpr index_t none = std::numeric_limits<index_t>::max();
+
+    struct Bounds {
+        std::size_t writes_end;
+        std::size_t reads_end;
+    };
+
+    struct ResourceState {
+        index_t last_writer = none;
+        std::vector<index_t> readers;
+    };
+
+    // Resolves the dependencies of the task on the tasks before it, in the order they were recorded.
+    template<class Depend>
+    void resolve(std::size_t task, index_t self, std::unordered_map<resource_id, ResourceState>& resources, Depend&& depend) const;
+
+    std::vector<resource_id> ids;
+    std::vector<Bounds> bounds;
+};
+
+
+template<std::ranges::input_range WRange, std::ranges::input_range RRange>
+    requires std::convertible_to<std::ranges::range_value_t<WRange>, resource_id>
+&& std::convertible_to<std::ranges::range_value_t<RRange>, resource_id>
+std::size_t TaskGraphRecorder::add(WRange&& writes, RRange&& reads) {
+    append_sorted_ids(ids, std::forward<WRange>(writes));
+    const std::size_t writes_end = ids.size();
+    append_sorted_ids(ids, std::forward<RRange>(reads));
+
+    bounds.push_back({ writes_end, ids.size() });
+    return bounds.size() - 1;
+}
+
+template<class Depend>
+void TaskGraphRecorder::resolve(std::size_t task, index_t self, std::unordered_map<resource_id, ResourceState>& resources, Depend&& depend) const {
+    const std::size_t begin = task == 0 ? 0 : bounds[task - 1].reads_end;
+    const auto [writes_end, reads_end] = bounds[task];
+
+    for (std::size_t i = begin; i < writes_end; ++i) {
+        ResourceState& state = resources[ids[i]];
+
+        if (!state.readers.empty()) {
+            for (index_t reader : state.readers) depend(reader);
+        }
+        else if (state.last_writer != none) {
+            depend(state.last_writer);
+        }
+
+        state.last_writer = self;
+        state.readers.clear();
+    }
+
+    for (std::size_t i = writes_end; i < reads_end; ++i) {
+        ResourceState& state = resources[ids[i]];
+        if (state.last_writer == self) continue;
+
+        if (state.last_writer != none) depend(state.last_writer);
+        state.readers.push_back(self);
+    }
+}
+
+inline TaskGraph TaskGraphRecorder::build() const {
+    static std::atomic<std::uint64_t> next_id{ 1 };
+
+    const std::size_t n = bounds.size();
+    TaskGraph graph;
+    graph.id = next_id.fetch_add(1, std::memory_order_relaxed);
+    graph.in_degrees.assign(n, 0);
+
+    std::unordered_map<resource_id, ResourceState> resources;
+    std::vector<std::pair<index_t, index_t>> edges;
+
+    // A task listed under several resources of another one still gives a single edge.
+    std::vector<std::size_t> stamps(2 * n, n);
+
+    for (std::size_t task = 0; task < n; ++task) {
+        resolve(task, static_cast<index_t>(task), resources, [&](index_t dep) {
+            if (std::exchange(stamps[dep], task) == task) return;
+            edges.emplace_back(dep, static_cast<index_t>(task));
+            graph.in_degrees[task]++;
+            });
+    }
+
+    graph.dependents_begin.assign(n + 1, 0);
+    for (const auto& edge : edges) graph.dependents_begin[edge.first + 1]++;
+    for (std::size_t i = 0; i < n; ++i) graph.dependents_begin[i + 1] += graph.dependents_begin[i];
+
+    graph.dependents.resize(edges.size());
+    std::vector<index_t> fill(graph.dependents_begin.begin(), graph.dependents_begin.end() - 1);
+    for (const auto& edge : edges) graph.dependents[fill[edge.first]++] = edge.second;
+
+    // Replaying the tasks once more on top of the final state finds the edges between two submissions,
+    //  the tasks of the second one are numbered from n.
+    std::vector<index_t> exit_of(n, none);
+    graph.previous_begin.assign(n + 1, 0);
+
+    for (std::size_t task = 0; task < n; ++task) {
+        resolve(task, static_cast<index_t>(n + task), resources, [&](index_t dep) {
+            if (dep >= n || std::exchange(stamps[n + dep], task) == task) return;
+
+            if (exit_of[dep] == none) {
+                exit_of[dep] = static_cast<index_t>(graph.exits.size());
+                graph.exits.push_back(dep);
+            }
+            graph.previous.push_back(exit_of[dep]);
+            });
+        graph.previous_begin[task + 1] = static_cast<index_t>(graph.previous.size());
+    }
+
+    return graph;
+}
+
+
+#endif // TASK_GRAPH_HPP
@@ -10,6 +10,7 @@
 #include <ranges>
 #include <string>
 #include <thread>
+#include <type_traits>
 
 #include "queue.hpp"
 
@@ -63,29 +64,36 @@ inline void wait_for_time_or_done(std::atomic<bool>& done, std::size_t timeout_m
     } \
     static bool name ## _inner()
 
+// Resource ranges and nodes are listed on their own, ids are converted.
+template<class... Args>
+using listed_resource = std::conditional_t<sizeof...(Args) != 0 && (std::is_same_v<std::decay_t<Args>, resource_range> && ...), resource_range,
+    std::conditional_t<sizeof...(Args) != 0 && (std::is_same_v<std::decay_t<Args>, resource_node> && ...), resource_node, resource_id>>;
+
 template<class... Args>
 inline auto writes(Args&&... args) {
+    using Resource = listed_resource<Args...>;
     if constexpr (sizeof...(args) == 0) {
         return std::ranges::empty_view<resource_id>();
     }
     else if constexpr (sizeof...(args) == 1) {
-        return std::ranges::single_view<resource_id>(args...);
+        return std::ranges::single_view<Resource>(static_cast<Resource>(args)...);
     }
     else {
-        return std::array<resource_id, sizeof...(args)>{static_cast<resource_id>(args)...};
+        return std::array<Resource, sizeof...(args)>{static_cast<Resource>(args)...};
     }
 }
 
 template<class... Args>
 inline auto reads(Args&&... args) {
+    using Resource = listed_resource<Args...>;
     if constexpr (sizeof...(args) == 0) {
         return std::ranges::empty_view<resource_id>();
     }
     else if constexpr (sizeof...(args) == 1) {
-        return std::ranges::single_view<resource_id>(args...);
+        return std::ranges::single_view<Resource>(static_cast<Resource>(args)...);
     }
     else {
-        return std::array<resource_id, sizeof...(args)>{static_cast<resource_id>(args)...};
+        return std::array<Resource, sizeof...(args)>{static_cast<Resource>(args)...};
     }
 }
 
@@ -0,0 +1,194 @@
+///**
+// * Tests the trace written by a queue with tracing: a slice for every task that ran, a flow arrow
+// *  for every dependency between two of them, also through the groups of readers, and the events
+// *  lost once the logs of the threads wrap around.
+// *
+// */
+//
+//#include <cstddef>
+//
+//#include <atomic>
+//#include <iostream>
+//#include <functional>
+//#include <sstream>
+//#include <string>
+//#include <vector>
+//
+//#include "test-common.hpp"
+//
+//#include "queue.hpp"
+//
+//namespace {
+//
+//    using TracingQueue = BasicQueue<TracingQueueTraits<>>;
+//
+//    std::size_t count_of(const std::string& text, const std::string& pattern) {
+//        std::size_t count = 0;
+//        for (std::size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) ++count;
+//        return count;
+//    }
+//
+//    std::string trace_of(const TracingQueue& queue) {
+//        std::ostringstream out;
+//        queue.write_trace(out);
+//        return out.str();
+//    }
+//
+//} // namespace
+//
+//TEST_CASE(chain_and_readers, "a chain of writers and readers between two writers are joined by arrows") {
+//    constexpr std::size_t chain = 10;
+//    constexpr std::size_t readers = 3;
+//
+//    TracingQueue queue;
+//
+//    for (std::size_t i = 0; i < chain; ++i) {
+//        queue.enqueue([]() {}, writes(0), reads());
+//    }
+//    // The readers wait for the first writer, the second one for all of the readers.
+//    queue.enqueue([]() {}, writes(1), reads());
+//    for (std::size_t i = 0; i < readers; ++i) {
+//        queue.enqueue([]() {}, writes(), reads(1));
+//    }
+//    queue.enqueue([]() {}, writes(1), reads());
+//
+//    queue.serve();
+//    const std::string trace = trace_of(queue);
+//
+//    const std::size_t slices = count_of(trace, "\"ph\":\"X\"");
+//    const std::size_t arrows = count_of(trace, "\"ph\":\"s\"");
+//    const std::size_t arrow_ends = count_of(trace, "\"ph\":\"f\"");
+//
+//    if (slices != chain + readers + 2) {
+//        PRINT_INDENTED("The trace has " << slices << " task slices, expected " << chain + readers + 2);
+//        return false;
+//    }
+//    if (arrows != chain - 1 + 2 * readers || arrow_ends != arrows) {
+//        PRINT_INDENTED("The trace has " << arrows << " arrows starting and " << arrow_ends << " ending, expected " << chain - 1 + 2 * readers);
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(graph_edges, "a submitted graph has an arrow for every edge, and to the next submission from its exits") {
+//    TaskGraphRecorder recorder;
+//    recorder.add(writes(0), reads());
+//    recorder.add(writes(1), reads(0));
+//    recorder.add(writes(2), reads(0));
+//    const TaskGraph graph = recorder.build();
+//
+//    const std::vector<std::function<void()>> tasks(3, []() {});
+//
+//    TracingQueue queue;
+//    queue.submit(graph, tasks);
+//    queue.submit(graph, tasks);
+//    queue.serve();
+//
+//    const std::string trace = trace_of(queue);
+//    const std::size_t slices = count_of(trace, "\"ph\":\"X\"");
+//    const std::size_t arrows = count_of(trace, "\"ph\":\"s\"");
+//
+//    if (slices != 6) {
+//        PRINT_INDENTED("The trace has " << slices << " task slices, expected 6");
+//        return false;
+//    }
+//    // Two edges within every submission. In the second one, the writer of 0 waits for the two readers
+//    //  of the first, and each of them for the previous writer of its own resource.
+//    if (arrows != 8) {
+//        PRINT_INDENTED("The trace has " << arrows << " arrows, expected 8");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(worker_threads, "the tasks run by the worker threads of the queue are all in the trace") {
+//    constexpr std::size_t workers = 4;
+//    constexpr std::size_t tasks = 2'000;
+//
+//    TracingQueue queue(QueueOptions{ .worker_threads = workers });
+//    std::atomic<std::size_t> runs{ 0 };
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([&runs]() {
+//            runs++;
+//            }, writes(i % 8), reads((i + 1) % 8));
+//    }
+//    queue.wait_idle();
+//
+//    const std::string trace = trace_of(queue);
+//    const std::size_t slices = count_of(trace, "\"ph\":\"X\"");
+//
+//    if (runs.load() != tasks || slices != tasks) {
+//        PRINT_INDENTED("Ran " << runs.load() << " tasks and the trace has " << slices << " task slices, expected " << tasks);
+//        return false;
+//    }
+//    if (count_of(trace, "\"overwritten_events\":0}") != 1) {
+//        PRINT_INDENTED("Events were lost although the logs were large enough");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//TEST_CASE(wrap_around, "small logs keep the latest events and count the lost ones") {
+//    constexpr std::size_t capacity = 64;
+//    constexpr std::size_t tasks = 1'000;
+//
+//    TracingQueue queue(QueueOptions{ .trace_buffer_capacity = capacity });
+//
+//    for (std::size_t i = 0; i < tasks; ++i) {
+//        queue.enqueue([]() {}, writes(0), reads());
+//    }
+//    queue.serve();
+//
+//    const std::string trace = trace_of(queue);
+//    const std::size_t slices = count_of(trace, "\"ph\":\"X\"");
+//
+//    if (slices == 0 || slices > capacity) {
+//        PRINT_INDENTED("The trace has " << slices << " task slices, expected at most " << capacity << " but some");
+//        return false;
+//    }
+//    if (count_of(trace, "\"overwritten_events\":0}") != 0) {
+//        PRINT_INDENTED("No events were counted as lost");
+//        return false;
+//    }
+//
+//    return true;
+//}
+//
+//int main() {
+//    std::size_t failed = 0;
+//    std::size_t total = 0;
+//
+//    ++total;
+//    if (!chain_and_readers()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!graph_edges()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!worker_threads()) {
+//        ++failed;
+//    }
+//
+//    ++total;
+//    if (!wrap_around()) {
+//        ++failed;
+//    }
+//
+//    RESET_INDENT();
+//    PRINT_INDENTED();
+//
+//    if (failed == 0) {
+//        PRINT_INDENTED("All test cases passed");
+//    }
+//    else {
+//        PRINT_INDENTED("Failed " << failed << " out of " << total << " tests");
+//    }
+//}
@@ -0,0 +1,122 @@
+#ifndef UNIQUE_TASK_HPP
+#define UNIQUE_TASK_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only type-erased holder of a void() callable, the counterpart of std::function
+//  that also accepts move-only callables.
+// Callables of up to InlineSize bytes that can be moved without throwing are stored
+//  in place, only bigger ones are allocated on the heap.
+template<std::size_t InlineSize>
+class UniqueTask {
+public:
+    UniqueTask() noexcept = default;
+
+    template<class Func>
+        requires (!std::is_same_v<std::decay_t<Func>, UniqueTask>) && std::is_invocable_v<std::decay_t<Func>&>
+    UniqueTask(Func&& func) {
+        emplace(std::forward<Func>(func));
+    }
+
+    UniqueTask(UniqueTask&& other) noexcept {
+        take(other);
+    }
+
+    UniqueTask& operator=(UniqueTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    UniqueTask(const UniqueTask&) = delete;
+    UniqueTask& operator=(const UniqueTask&) = delete;
+
+    ~UniqueTask() {
+        reset();
+    }
+
+    // Replaces the held callable, constructs the new one directly in the buffer when it fits.
+    template<class Func>
+    void emplace(Func&& func);
+
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+    // The holder must not be empty.
+    void operator()() {
+        ops->invoke(storage);
+    }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    template<class Func>
+    static constexpr bool stored_inline = sizeof(Func) <= InlineSize
+        && alignof(Func) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<Func>;
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Moves the callable to the other storage and destroys the source.
+        void (*relocate)(void* from, void* to) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<class Func>
+    static constexpr Ops inline_ops{
+        [](void* storage) { (*std::launder(static_cast<Func*>(storage)))(); },
+        [](void* from, void* to) noexcept {
+            Func* source = std::launder(static_cast<Func*>(from));
+            ::new (to) Func(std::move(*source));
+            source->~Func();
+        },
+        [](void* storage) noexcept { std::launder(static_cast<Func*>(storage))->~Func(); },
+    };
+
+    // The buffer only holds the pointer to the callable.
+    template<class Func>
+    static constexpr Ops heap_ops{
+        [](void* storage) { (**std::launder(static_cast<Func**>(storage)))(); },
+        [](void* from, void* to) noexcept { ::new (to) Func*(*std::launder(static_cast<Func**>(from))); },
+        [](void* storage) noexcept { delete *std::launder(static_cast<Func**>(storage)); },
+    };
+
+    void take(UniqueTask& other) noexcept {
+        if (other.ops) {
+            other.ops->relocate(other.storage, storage);
+            ops = std::exchange(other.ops, nullptr);
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+    const Ops* ops = nullptr;
+};
+
+
+template<std::size_t InlineSize>
+template<class Func>
+void UniqueTask<InlineSize>::emplace(Func&& func) {
+    using F = std::decay_t<Func>;
+
+    reset();
+    if constexpr (stored_inline<F>) {
+        ::new (static_cast<void*>(storage)) F(std::forward<Func>(func));
+        ops = &inline_ops<F>;
+    }
+    else {
+        ::new (static_cast<void*>(storage)) F*(new F(std::forward<Func>(func)));
+        ops = &heap_ops<F>;
+    }
+}
+
+
+#endif // UNIQUE_TASK_HPP